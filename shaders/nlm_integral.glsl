@@ -0,0 +1,30 @@
+// Prefix sums of the integral NLM passes, included by nlm_integral_rows.comp
+// and nlm_integral_cols.comp. A prefix over a whole row or column of squared
+// differences on the 0..255 scale reaches ~1e9 on large images, where a float
+// step is ~100, so the sums start again from zero every PREFIX_BLOCK samples:
+// prefix[base + j] holds the sum from the start of j's block,
+// (j - 1) / PREFIX_BLOCK, to sample j - 1, and the last entry of a block is
+// its total. Must match PREFIX_BLOCK in src/integral_nlm.cpp.
+
+const int PREFIX_BLOCK = 64;
+
+layout(std430, binding = 3) buffer buf4
+{
+  float prefix[];
+};
+
+int prefixBlock(int j)
+{
+  return max(j - 1, 0) / PREFIX_BLOCK;
+}
+
+// Sum of samples lo..end - 1: the two partial sums plus the totals of the
+// blocks in between.
+float windowSum(int base, int lo, int end)
+{
+  float sum = prefix[base + end] - prefix[base + lo];
+  for (int b = prefixBlock(lo); b < prefixBlock(end); ++b) {
+    sum += prefix[base + (b + 1) * PREFIX_BLOCK];
+  }
+  return sum;
+}
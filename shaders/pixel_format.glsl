@@ -0,0 +1,60 @@
+// Storage format of the image buffers, included by every filter shader.
+// Define PIXEL_SRC_BINDING and/or PIXEL_DST_BINDING before the include to
+// get loadPixel()/storePixel() on those bindings. Each binding is declared
+// once per format; FORMAT picks the view, the other branches fold away when
+// the pipeline is specialised. Filters always compute in fp32.
+//
+//   0: RGBA32F, one vec4 per pixel
+//   1: RGBA16F, two channels per uint (packHalf2x16)
+//   2: RGBA8 unorm, one uint per pixel (packUnorm4x8)
+
+layout (constant_id = 7) const int FORMAT = 0;
+
+#ifdef PIXEL_SRC_BINDING
+layout(std430, binding = PIXEL_SRC_BINDING) readonly buffer src32 {
+  vec4 src32Data[];
+};
+layout(std430, binding = PIXEL_SRC_BINDING) readonly buffer src16 {
+  uvec2 src16Data[];
+};
+layout(std430, binding = PIXEL_SRC_BINDING) readonly buffer src8 {
+  uint src8Data[];
+};
+
+vec4 loadPixel(uint i)
+{
+  if (FORMAT == 1) {
+    uvec2 p = src16Data[i];
+    return vec4(unpackHalf2x16(p.x), unpackHalf2x16(p.y));
+  }
+  if (FORMAT == 2) {
+    return unpackUnorm4x8(src8Data[i]);
+  }
+  return src32Data[i];
+}
+#endif
+
+#ifdef PIXEL_DST_BINDING
+layout(std430, binding = PIXEL_DST_BINDING) writeonly buffer dst32 {
+  vec4 dst32Data[];
+};
+layout(std430, binding = PIXEL_DST_BINDING) writeonly buffer dst16 {
+  uvec2 dst16Data[];
+};
+layout(std430, binding = PIXEL_DST_BINDING) writeonly buffer dst8 {
+  uint dst8Data[];
+};
+
+void storePixel(uint i, vec4 value)
+{
+  if (FORMAT == 1) {
+    dst16Data[i] = uvec2(packHalf2x16(value.rg), packHalf2x16(value.ba));
+  }
+  else if (FORMAT == 2) {
+    dst8Data[i] = packUnorm4x8(value);
+  }
+  else {
+    dst32Data[i] = value;
+  }
+}
+#endif
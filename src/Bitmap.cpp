@@ -2,49 +2,52 @@
 #include <fstream>
 #include <cstring>
 
-struct Pixel { unsigned char r, g, b; };
-
-void WriteBMP(const char* fname, Pixel* a_pixelData, int width, int height)
+// 24-bit BMP: B, G, R per pixel, every row padded to a multiple of 4 bytes
+// and the rows stored bottom-up. One row is converted at a time.
+//
+void SaveBMP(const char* fname, const unsigned int* pixels, int w, int h)
 {
-  int paddedsize = (width*height) * sizeof(Pixel);
+  const int rowSize    = (3*w + 3) & ~3;
+  const int paddedsize = rowSize*h;
+  const int filesize   = 54 + paddedsize;
 
   unsigned char bmpfileheader[14] = {'B','M', 0,0,0,0, 0,0, 0,0, 54,0,0,0};
   unsigned char bmpinfoheader[40] = {40,0,0,0, 0,0,0,0, 0,0,0,0, 1,0, 24,0};
 
-  bmpfileheader[ 2] = (unsigned char)(paddedsize    );
-  bmpfileheader[ 3] = (unsigned char)(paddedsize>> 8);
-  bmpfileheader[ 4] = (unsigned char)(paddedsize>>16);
-  bmpfileheader[ 5] = (unsigned char)(paddedsize>>24);
-
-  bmpinfoheader[ 4] = (unsigned char)(width    );
-  bmpinfoheader[ 5] = (unsigned char)(width>> 8);
-  bmpinfoheader[ 6] = (unsigned char)(width>>16);
-  bmpinfoheader[ 7] = (unsigned char)(width>>24);
-  bmpinfoheader[ 8] = (unsigned char)(height    );
-  bmpinfoheader[ 9] = (unsigned char)(height>> 8);
-  bmpinfoheader[10] = (unsigned char)(height>>16);
-  bmpinfoheader[11] = (unsigned char)(height>>24);
+  bmpfileheader[ 2] = (unsigned char)(filesize    );
+  bmpfileheader[ 3] = (unsigned char)(filesize>> 8);
+  bmpfileheader[ 4] = (unsigned char)(filesize>>16);
+  bmpfileheader[ 5] = (unsigned char)(filesize>>24);
+
+  bmpinfoheader[ 4] = (unsigned char)(w    );
+  bmpinfoheader[ 5] = (unsigned char)(w>> 8);
+  bmpinfoheader[ 6] = (unsigned char)(w>>16);
+  bmpinfoheader[ 7] = (unsigned char)(w>>24);
+  bmpinfoheader[ 8] = (unsigned char)(h    );
+  bmpinfoheader[ 9] = (unsigned char)(h>> 8);
+  bmpinfoheader[10] = (unsigned char)(h>>16);
+  bmpinfoheader[11] = (unsigned char)(h>>24);
+  bmpinfoheader[20] = (unsigned char)(paddedsize    );
+  bmpinfoheader[21] = (unsigned char)(paddedsize>> 8);
+  bmpinfoheader[22] = (unsigned char)(paddedsize>>16);
+  bmpinfoheader[23] = (unsigned char)(paddedsize>>24);
 
   std::ofstream out(fname, std::ios::out | std::ios::binary);
   out.write((const char*)bmpfileheader, 14);
   out.write((const char*)bmpinfoheader, 40);
-  out.write((const char*)a_pixelData, paddedsize);
-  out.flush();
-  out.close();
-}
 
-void SaveBMP(const char* fname, const unsigned int* pixels, int w, int h)
-{
-  std::vector<Pixel> pixels2(w*h);
-
-  for (size_t i = 0; i < pixels2.size(); i++)
+  std::vector<unsigned char> row(rowSize, 0); // padding stays zero
+  for (int y = h - 1; y >= 0; y--)
   {
-    Pixel px;
-    px.r       = (pixels[i] & 0x00FF0000) >> 16;
-    px.g       = (pixels[i] & 0x0000FF00) >> 8;
-    px.b       = (pixels[i] & 0x000000FF);
-    pixels2[i] = px;
+    const unsigned int* src = pixels + size_t(w)*y;
+    for (int x = 0; x < w; x++)
+    {
+      row[3*x + 0] = (unsigned char)((src[x] & 0x000000FF)      );
+      row[3*x + 1] = (unsigned char)((src[x] & 0x0000FF00) >>  8);
+      row[3*x + 2] = (unsigned char)((src[x] & 0x00FF0000) >> 16);
+    }
+    out.write((const char*)&row[0], rowSize);
   }
-
-  WriteBMP(fname, &pixels2[0], w, h);
-}
\ No newline at end of file
+  out.flush();
+  out.close();
+}
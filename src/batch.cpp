@@ -0,0 +1,215 @@
+#include "batch.hpp"
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+
+// Formats stb_image decodes, and raw frame dumps (raw_frame.hpp).
+static bool isImageFile(const std::string &a_name)
+{
+    static const char *extensions[] = {"png", "jpg", "jpeg", "bmp", "tga",
+                                       "hdr", "psd", "gif", "pnm", "ppm",
+                                       "pgm", "raw"};
+    size_t dot = a_name.rfind('.');
+    if (dot == std::string::npos) {
+        return false;
+    }
+    std::string ext = a_name.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    for (const char *known : extensions) {
+        if (ext == known) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool isDirectory(const std::string &a_path)
+{
+    struct stat info;
+    return stat(a_path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+std::vector<std::string> listBatchInputs(const std::string &a_source)
+{
+    std::vector<std::string> inputs;
+    if (isDirectory(a_source)) {
+        DIR *dir = opendir(a_source.c_str());
+        if (!dir) {
+            throw std::runtime_error("failed to open " + a_source);
+        }
+        while (struct dirent *entry = readdir(dir)) {
+            const std::string path = a_source + "/" + entry->d_name;
+            if (isImageFile(entry->d_name) && !isDirectory(path)) {
+                inputs.push_back(path);
+            }
+        }
+        closedir(dir);
+        std::sort(inputs.begin(), inputs.end());
+        return inputs;
+    }
+
+    std::ifstream list(a_source);
+    if (!list) {
+        throw std::runtime_error("failed to open " + a_source);
+    }
+    std::string line;
+    while (std::getline(list, line)) {
+        const size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos) {
+            continue;
+        }
+        const size_t last = line.find_last_not_of(" \t\r");
+        inputs.push_back(line.substr(first, last - first + 1));
+    }
+    return inputs;
+}
+
+std::vector<std::string> batchOutputPaths(
+    const std::string &a_dir, const std::vector<std::string> &a_inputs,
+    const std::string &a_extension)
+{
+    if (mkdir(a_dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::runtime_error("failed to create " + a_dir);
+    }
+    std::vector<std::string> outputs;
+    std::set<std::string> taken;
+    for (size_t i = 0; i < a_inputs.size(); ++i) {
+        const std::string &input = a_inputs[i];
+        size_t slash = input.rfind('/');
+        std::string name =
+            slash == std::string::npos ? input : input.substr(slash + 1);
+        size_t dot = name.rfind('.');
+        if (dot != std::string::npos && dot > 0) {
+            name.erase(dot);
+        }
+        std::string file = name + "." + a_extension;
+        for (int n = 1; !taken.insert(file).second; ++n) {
+            file = name + "-" + std::to_string(n) + "." + a_extension;
+        }
+        outputs.push_back(a_dir + "/" + file);
+    }
+    return outputs;
+}
+
+void appendProfile(const std::string &a_path, const std::string &a_name,
+                   unsigned int a_width, unsigned int a_height,
+                   const FrameTimes &a_times)
+{
+    std::ofstream out(a_path.c_str(), std::ios::app);
+    if (!out) {
+        throw std::runtime_error("cannot write " + a_path);
+    }
+    if (out.tellp() == 0) {
+        out << "image,width,height,load_ms,gpu_upload_ms,gpu_dispatch_ms,"
+               "gpu_readback_ms,gpu_ms,wait_ms,readback_ms,save_ms\n";
+    }
+    // names are quoted, the only field that may hold a comma
+    std::string quoted = a_name;
+    for (size_t i = quoted.find('"'); i != std::string::npos;
+         i = quoted.find('"', i + 2)) {
+        quoted.insert(i, 1, '"');
+    }
+    out << '"' << quoted << "\"," << a_width << "," << a_height << ","
+        << a_times.load << ",";
+    // untimed copies are left empty rather than reported as 0
+    if (a_times.copiesTimed) {
+        out << a_times.gpuUpload;
+    }
+    out << "," << a_times.gpuDispatch << ",";
+    if (a_times.copiesTimed) {
+        out << a_times.gpuReadback;
+    }
+    out << "," << a_times.gpu << "," << a_times.wait << ","
+        << a_times.readback << "," << a_times.save << "\n";
+}
+
+void BatchStats::add(const std::string &a_name, unsigned int a_width,
+                     unsigned int a_height, const FrameTimes &a_times)
+{
+    const double mp = double(a_width) * a_height / 1e6;
+    // cost of this image alone, as if nothing overlapped
+    const double gpu = a_times.gpu > 0 ? a_times.gpu : a_times.wait;
+    const double total = a_times.load + gpu + a_times.readback + a_times.save;
+    if (print) {
+        std::cout << a_name << ": " << a_width << "x" << a_height
+                  << " load " << a_times.load << " ms, gpu " << a_times.gpu
+                  << " ms, wait " << a_times.wait << " ms, readback "
+                  << a_times.readback << " ms, save " << a_times.save
+                  << " ms, " << mp / (total / 1000.0) << " MP/s" << std::endl;
+    }
+    ++images;
+    megapixels += mp;
+    sum.load += a_times.load;
+    sum.gpu += a_times.gpu;
+    sum.gpuUpload += a_times.gpuUpload;
+    sum.gpuDispatch += a_times.gpuDispatch;
+    sum.gpuReadback += a_times.gpuReadback;
+    sum.copiesTimed = sum.copiesTimed && a_times.copiesTimed;
+    sum.wait += a_times.wait;
+    sum.readback += a_times.readback;
+    sum.save += a_times.save;
+}
+
+void BatchStats::addFailure(const std::string &a_name,
+                            const std::string &a_reason)
+{
+    if (print) {
+        std::cout << a_name << ": skipped, " << a_reason << std::endl;
+    }
+    ++failed;
+}
+
+void BatchStats::report(double a_setupMs, double a_wallMs,
+                        int a_inFlight) const
+{
+    if (!print) {
+        return;
+    }
+    const double seconds = a_wallMs / 1000.0;
+    std::cout << "batch: " << images << " images (" << failed
+              << " skipped), " << megapixels << " MP in " << seconds
+              << " s after " << a_setupMs << " ms of setup" << std::endl;
+    if (images == 0) {
+        return;
+    }
+    std::cout << "  " << images / seconds << " images/s, "
+              << megapixels / seconds << " MP/s" << std::endl;
+    std::cout << "  mean per image: load " << sum.load / images
+              << " ms, gpu " << sum.gpu / images << " ms, wait "
+              << sum.wait / images << " ms, readback "
+              << sum.readback / images << " ms, save " << sum.save / images
+              << " ms" << std::endl;
+    if (sum.gpu > 0 && sum.copiesTimed) {
+        std::cout << "  mean gpu phases: upload " << sum.gpuUpload / images
+                  << " ms, dispatch " << sum.gpuDispatch / images
+                  << " ms, readback " << sum.gpuReadback / images << " ms"
+                  << std::endl;
+    }
+    else if (sum.gpu > 0) {
+        std::cout << "  mean gpu phases: dispatch " << sum.gpuDispatch / images
+                  << " ms, copies on the transfer queue not timed"
+                  << std::endl;
+    }
+
+    // Host and GPU are each busy for a known time; whatever the wall clock
+    // saved over running them back to back was spent in parallel.
+    const double host = sum.load + sum.readback + sum.save;
+    std::cout << "  " << a_inFlight << " in flight: host busy " << host
+              << " ms, ";
+    if (sum.gpu > 0) {
+        const double overlap = std::max(host + sum.gpu - a_wallMs, 0.0);
+        std::cout << "gpu busy " << sum.gpu << " ms, overlapped " << overlap
+                  << " ms (" << 100.0 * overlap / std::min(host, sum.gpu)
+                  << "% of the shorter)" << std::endl;
+    }
+    else {
+        std::cout << "waited on the gpu " << sum.wait
+                  << " ms (no timestamps)" << std::endl;
+    }
+}
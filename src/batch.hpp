@@ -0,0 +1,74 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Inputs of a batch run: the image files of a directory in name order, or
+// the non-empty lines of a list file. Throws std::runtime_error when
+// a_source is neither.
+std::vector<std::string> listBatchInputs(const std::string &a_source);
+
+// a_dir/<input file name without extension>.<a_extension> for each of
+// a_inputs, creating a_dir if needed. Inputs that would write the same file,
+// such as a.png and a.jpg, or one name in two directories of a list file,
+// get -1, -2, ... appended in input order instead of overwriting each other.
+std::vector<std::string> batchOutputPaths(
+    const std::string &a_dir, const std::vector<std::string> &a_inputs,
+    const std::string &a_extension);
+
+// Milliseconds spent on one image. load, wait, readback and save are
+// steady_clock time on the host; the gpu fields come from timestamps
+// scaled by timestampPeriod and are 0 when the queue has none.
+struct FrameTimes {
+    double load = 0;  // decode, copy into the upload buffer, record, submit
+    double gpu = 0;   // upload + dispatch + readback below
+    double gpuUpload = 0;    // staging copy in
+    double gpuDispatch = 0;
+    double gpuReadback = 0;  // staging copy out
+    // false when the copies ran on a transfer queue, which is not
+    // timestamped: gpuUpload and gpuReadback are unknown and gpu is the
+    // dispatch alone
+    bool copiesTimed = true;
+    double wait = 0;  // host blocked on the image's fence
+    double readback = 0;  // mapped result to RGBA8
+    double save = 0;      // encode
+};
+
+// Appends a_times of one image as a CSV row to a_path, writing the header
+// first when the file is new or empty, so runs can be collected and
+// trended. Throws std::runtime_error when a_path cannot be opened.
+void appendProfile(const std::string &a_path, const std::string &a_name,
+                   unsigned int a_width, unsigned int a_height,
+                   const FrameTimes &a_times);
+
+inline double elapsedMs(const std::chrono::steady_clock::time_point &a_start)
+{
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - a_start)
+        .count();
+}
+
+// Prints one line per image and the totals of the run, including how much
+// of the host and GPU work ran concurrently; only counts with a_print false.
+class BatchStats {
+    bool print;
+    size_t images = 0;
+    size_t failed = 0;
+    double megapixels = 0;
+    FrameTimes sum;
+
+public:
+    explicit BatchStats(bool a_print) : print(a_print) {}
+
+    void add(const std::string &a_name, unsigned int a_width,
+             unsigned int a_height, const FrameTimes &a_times);
+    void addFailure(const std::string &a_name, const std::string &a_reason);
+    size_t failures() const { return failed; }
+    // a_setupMs: device, pipeline and layout creation; a_wallMs: the loop
+    // over all inputs with a_inFlight images submitted ahead.
+    void report(double a_setupMs, double a_wallMs, int a_inFlight) const;
+};
+
+#endif // BATCH_HPP
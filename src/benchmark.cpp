@@ -0,0 +1,59 @@
+#include "benchmark.hpp"
+#include <string.h>
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include "bilateral.hpp"
+
+// Deterministic test pattern: smooth gradients plus LCG noise, so the
+// benchmark needs no input file and every run sees identical pixels.
+static void fillTestImage(std::vector<float> &image, unsigned int width,
+                          unsigned int height)
+{
+    unsigned int seed = 12345;
+    for (unsigned int i = 0; i < height; ++i) {
+        for (unsigned int j = 0; j < width; ++j) {
+            for (unsigned int k = 0; k < 3; ++k) {
+                seed = seed * 1664525u + 1013904223u;
+                float noise = float(seed >> 8) / float(1 << 24) - 0.5f;
+                float base = (k == 0 ? float(j) / width
+                                     : k == 1 ? float(i) / height : 0.5f);
+                image[4 * width * i + 4 * j + k] = base + 0.1f * noise;
+            }
+            image[4 * width * i + 4 * j + 3] = 1.0f;
+        }
+    }
+}
+
+void runThreadScalingBenchmark(unsigned int width, unsigned int height,
+                               int maxThreads, const BilateralParams &params)
+{
+    std::vector<float> pixels(4 * width * height);
+    std::vector<float> reference(pixels.size());
+    std::vector<float> dst(pixels.size());
+    fillTestImage(pixels, width, height);
+    PlanarImage src(width, height);
+    PlanarImage out(width, height);
+    src.fromInterleaved(pixels.data());
+
+    std::cout << "threads,seconds,speedup,identical" << std::endl;
+    double baseTime = 0;
+    for (int threads = 1; threads <= maxThreads; ++threads) {
+        BilateralFilter b(src, out, params);
+        b.setThreads(threads);
+
+        auto t1 = std::chrono::steady_clock::now();
+        b.run();
+        auto t2 = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(t2 - t1).count();
+        if (threads == 1) {
+            baseTime = seconds;
+        }
+        std::vector<float> &result = threads == 1 ? reference : dst;
+        out.toInterleaved(result.data());
+        bool identical = memcmp(result.data(), reference.data(),
+                                reference.size() * sizeof(float)) == 0;
+        std::cout << threads << "," << seconds << "," << baseTime / seconds
+                  << "," << (identical ? "yes" : "no") << std::endl;
+    }
+}
@@ -0,0 +1,12 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include "filter_params.hpp"
+
+// Filters a fixed synthetic width x height image with BilateralFilter using
+// 1 .. maxThreads threads and prints time, speedup and whether every run
+// reproduced the single-threaded output bit for bit.
+void runThreadScalingBenchmark(unsigned int width, unsigned int height,
+                               int maxThreads, const BilateralParams &params);
+
+#endif // BENCHMARK_HPP
@@ -1,79 +1,54 @@
 #include "bilateral.hpp"
 #include "cmath"
-float weights[1000];
+
 void BilateralFilter::run()
 {
     omp_set_dynamic(0);
-    omp_set_num_threads(4);
-    unsigned int i;
-    unsigned int j;
-    unsigned int k;
-#pragma omp parallel for private(i) private(j) private(k)
-    for (i = 0; i < height; ++i) {
-        for (j = 0; j < width; ++j) {
-            for (k = 0; k < 3; ++k) {
-                newImage[4 * width * i + 4 * j + k] =
-                    newColor(i, j, k);
-            }
-            newImage[4 * width * i + 4 * j + 3] =
-                oldImage[4 * width * i + 4 * j + 3];
+    int i;
+#pragma omp parallel for num_threads(threads) schedule(static)
+    for (i = 0; i < int(height); ++i) {
+        for (unsigned int j = 0; j < width; ++j) {
+            newColor(i, j);
         }
     }
+    newImage.copyAlpha(oldImage);
 }
 
 float BilateralFilter::w(unsigned int row1, unsigned int column1,
                          unsigned int row2, unsigned int column2,
                          unsigned int i)
 {
-    return 1.f / (exp(pow(width * row2 + column2 - width * row1 - column1, 2) *
-                      1.f / (2 * pow(SYGMA1, 2))) *
-                  exp(pow(oldImage[4 * width * row2 + 4 * column2 + i] -
-                              oldImage[4 * width * row1 + 4 * column1 + i],
+    return 1.f / (exp((pow(int(row2) - int(row1), 2) +
+                       pow(int(column2) - int(column1), 2)) *
+                      1.f / (2 * pow(params.sigmaSpatial, 2))) *
+                  exp(pow(oldImage.row(i, row2)[column2] -
+                              oldImage.row(i, row1)[column1],
                           2) *
-                      1.f / (2 * pow(SYGMA2, 2))));
-}
-float BilateralFilter::C(unsigned int row, unsigned int column, unsigned int i)
-{
-    float resultValue = 0;
-    unsigned int currWeightCounter = 0;
-    float currWeight = 0;
-    for (int j = int(row) - RADIUS; j <= int(row) + RADIUS; ++j) {  // row
-        for (int k = int(column) - RADIUS; k <= int(column) + RADIUS;
-             ++k) {  // num in row
-            if ((j < 0) || (j >= height) || (k < 0) || (k >= width)) {
-                continue;
-            }
-            currWeight = w(row, column, (unsigned int)j, (unsigned int)k, i);
-            resultValue += currWeight;
-            weights[currWeightCounter] = currWeight;
-            currWeightCounter++;
-        }
-    }
-
-    return resultValue;
+                      1.f / (2 * pow(params.sigmaRange, 2))));
 }
 
-float BilateralFilter::newColor(unsigned int row, unsigned int column,
-                                unsigned int i)
+// Accumulates the weighted colour and the normalizer of all three channels in
+// a single walk over the window and divides once at the end.
+void BilateralFilter::newColor(unsigned int row, unsigned int column)
 {
-    float newColor;
-    float c;
-    uint currWeightCounter = 0;
-    c = C(row, column, i);
-    currWeightCounter = 0;
-    newColor = 0.0;
-    for (int j = int(row) - RADIUS; j <= int(row) + RADIUS; ++j) {  // row
-        for (int k = int(column) - RADIUS; k <= int(column) + RADIUS;
+    const int radius = params.radius;
+    float sum[3] = {0.0f, 0.0f, 0.0f};
+    float norm[3] = {0.0f, 0.0f, 0.0f};
+    for (int j = int(row) - radius; j <= int(row) + radius; ++j) {  // row
+        for (int k = int(column) - radius; k <= int(column) + radius;
              ++k) {  // num in row
             if ((j < 0) || (j >= height) || (k < 0) || (k >= width)) {
                 continue;
             }
-            else {
-                newColor += oldImage[4 * width * uint(j) + 4 * uint(k) + i] *
-                            weights[currWeightCounter] / c;
-                currWeightCounter++;
+            for (unsigned int i = 0; i < 3; ++i) {
+                float currWeight =
+                    w(row, column, (unsigned int)j, (unsigned int)k, i);
+                sum[i] += oldImage.row(i, j)[k] * currWeight;
+                norm[i] += currWeight;
             }
         }
     }
-    return newColor;
-}
\ No newline at end of file
+    for (unsigned int i = 0; i < 3; ++i) {
+        newImage.row(i, row)[column] = sum[i] / norm[i];
+    }
+}
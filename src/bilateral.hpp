@@ -1,21 +1,27 @@
-#define SYGMA1 35
-#define SYGMA2 35
-#define RADIUS 10
+#ifndef BILATERAL_HPP
+#define BILATERAL_HPP
+
 #include <iostream>
 #include <omp.h>
+#include "filter_params.hpp"
+#include "planar_image.hpp"
 
 
 class BilateralFilter {
     unsigned int width;
     unsigned int height;
+    int threads;
+    BilateralParams params;
 
 public:
    
-    float *oldImage;
-    float *newImage;
-    BilateralFilter(float *oldIm, float *newIm, unsigned int width_, unsigned int height_): oldImage(oldIm), newImage(newIm), width(width_), height(height_) {};
+    const PlanarImage &oldImage;
+    PlanarImage &newImage;
+    BilateralFilter(const PlanarImage &oldIm, PlanarImage &newIm, const BilateralParams &params_): width(oldIm.width()), height(oldIm.height()), threads(omp_get_max_threads()), params(params_), oldImage(oldIm), newImage(newIm) {};
+    void setThreads(int threads_) { threads = threads_ > 0 ? threads_ : omp_get_max_threads(); }
     void run();
     float w(unsigned int, unsigned int, unsigned int, unsigned int, unsigned int);
-    float C(unsigned int, unsigned int, unsigned int);
-    float newColor(unsigned int, unsigned int, unsigned int);
-};
\ No newline at end of file
+    void newColor(unsigned int, unsigned int);
+};
+
+#endif // BILATERAL_HPP
@@ -0,0 +1,263 @@
+#include "codec.hpp"
+#include <omp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stb_image_write.h>
+#include <algorithm>
+#include <atomic>
+#include "uncompressed.hpp"
+#ifdef VKFILTER_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef VKFILTER_ZLIB
+
+// Input bytes per strip at least; smaller images are one strip and deflate
+// like any single-threaded encoder.
+static const size_t pngStripBytes = size_t(1) << 20;
+
+// stb_image_write's default, stbi_write_png_compression_level.
+static const int pngLevel = 8;
+
+static void putBigEndian(unsigned char *a_dst, uint32_t a_value)
+{
+    a_dst[0] = (unsigned char)(a_value >> 24);
+    a_dst[1] = (unsigned char)(a_value >> 16);
+    a_dst[2] = (unsigned char)(a_value >> 8);
+    a_dst[3] = (unsigned char)a_value;
+}
+
+static bool writeChunk(FILE *a_file, const char *a_type,
+                       const unsigned char *a_data, size_t a_size)
+{
+    unsigned char header[8];
+    putBigEndian(header, uint32_t(a_size));
+    memcpy(header + 4, a_type, 4);
+    uLong crc = crc32(0, header + 4, 4);
+    if (a_size > 0) {  // crc32() of Z_NULL restarts the sum
+        crc = crc32(crc, a_data, uInt(a_size));
+    }
+    unsigned char trailer[4];
+    putBigEndian(trailer, uint32_t(crc));
+    return fwrite(header, 1, 8, a_file) == 8 &&
+           (a_size == 0 || fwrite(a_data, 1, a_size, a_file) == a_size) &&
+           fwrite(trailer, 1, 4, a_file) == 4;
+}
+
+static unsigned char paeth(int a_left, int a_up, int a_upLeft)
+{
+    const int p = a_left + a_up - a_upLeft;
+    const int pa = abs(p - a_left), pb = abs(p - a_up), pc = abs(p - a_upLeft);
+    if (pa <= pb && pa <= pc) {
+        return (unsigned char)a_left;
+    }
+    return (unsigned char)(pb <= pc ? a_up : a_upLeft);
+}
+
+// Filters one row of a_bytes into a_out (filter type byte first) with the
+// filter stb_image_write would pick: the smallest sum of absolute values.
+// a_prev is the row above, zeros for the first one.
+static void filterRow(const unsigned char *a_row, const unsigned char *a_prev,
+                      size_t a_bytes, unsigned char *a_out,
+                      unsigned char *a_scratch)
+{
+    const size_t bpp = 4;
+    long best = -1;
+    for (int type = 0; type < 5; ++type) {
+        long sum = 0;
+        for (size_t i = 0; i < a_bytes; ++i) {
+            const int left = i >= bpp ? a_row[i - bpp] : 0;
+            const int upLeft = i >= bpp ? a_prev[i - bpp] : 0;
+            const int up = a_prev[i];
+            int predicted = 0;
+            switch (type) {
+            case 1: predicted = left; break;
+            case 2: predicted = up; break;
+            case 3: predicted = (left + up) >> 1; break;
+            case 4: predicted = paeth(left, up, upLeft); break;
+            }
+            a_scratch[i] = (unsigned char)(a_row[i] - predicted);
+            sum += abs((signed char)a_scratch[i]);
+        }
+        if (best < 0 || sum < best) {
+            best = sum;
+            a_out[0] = (unsigned char)type;
+            memcpy(a_out + 1, a_scratch, a_bytes);
+        }
+    }
+}
+
+// Raw deflate of a_size bytes. Strips but the last end with a sync flush,
+// an empty stored block that leaves the stream byte-aligned and open, so
+// the next strip's stream can follow it directly.
+static bool deflateStrip(const unsigned char *a_data, size_t a_size,
+                         bool a_last, std::vector<unsigned char> &a_out)
+{
+    z_stream stream = {};
+    if (deflateInit2(&stream, pngLevel, Z_DEFLATED, -15, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    a_out.resize(deflateBound(&stream, uLong(a_size)) + 16);
+    stream.next_in = (Bytef *)a_data;
+    stream.avail_in = uInt(a_size);
+    stream.next_out = &a_out[0];
+    stream.avail_out = uInt(a_out.size());
+    const int result = deflate(&stream, a_last ? Z_FINISH : Z_SYNC_FLUSH);
+    const bool done = a_last ? result == Z_STREAM_END
+                             : result == Z_OK && stream.avail_in == 0;
+    a_out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return done;
+}
+
+// writePngStrips() calls running, on CodecPool workers or elsewhere.
+static std::atomic<int> pngEncoders(0);
+
+static bool writePngStrips(const std::string &a_fileName, int a_width,
+                           int a_height, const unsigned char *a_data)
+{
+    // encoders running at once share the cores rather than each starting a
+    // full OpenMP team
+    struct Encoder {
+        int count;
+        Encoder() : count(++pngEncoders) {}
+        ~Encoder() { --pngEncoders; }
+    } encoder;
+    const int threads = std::max(1, omp_get_max_threads() / encoder.count);
+
+    const size_t rowBytes = 4 * size_t(a_width);
+    const size_t filteredBytes = rowBytes + 1;
+    const int strips = int(std::max<size_t>(
+        1, std::min<size_t>(size_t(a_height),
+                            std::min<size_t>(
+                                filteredBytes * a_height / pngStripBytes,
+                                4 * size_t(threads)))));
+    std::vector<std::vector<unsigned char>> deflated(strips);
+    std::vector<uLong> adlers(strips);
+    std::vector<size_t> sizes(strips);
+    bool ok = true;
+
+#pragma omp parallel for num_threads(threads) schedule(dynamic) \
+    reduction(&& : ok)
+    for (int s = 0; s < strips; ++s) {
+        const int first = int(int64_t(a_height) * s / strips);
+        const int last = int(int64_t(a_height) * (s + 1) / strips);
+        std::vector<unsigned char> filtered(filteredBytes * (last - first));
+        std::vector<unsigned char> zeros(rowBytes, 0), scratch(rowBytes);
+        for (int y = first; y < last; ++y) {
+            const unsigned char *row = a_data + rowBytes * y;
+            filterRow(row, y > 0 ? row - rowBytes : &zeros[0], rowBytes,
+                      &filtered[filteredBytes * (y - first)], &scratch[0]);
+        }
+        sizes[s] = filtered.size();
+        adlers[s] = adler32(adler32(0, Z_NULL, 0), &filtered[0],
+                            uInt(filtered.size()));
+        ok = deflateStrip(&filtered[0], filtered.size(), s == strips - 1,
+                          deflated[s]) && ok;
+    }
+    if (!ok) {
+        return false;
+    }
+
+    uLong adler = adlers[0];
+    for (int s = 1; s < strips; ++s) {
+        adler = adler32_combine(adler, adlers[s], z_off_t(sizes[s]));
+    }
+
+    FILE *file = fopen(a_fileName.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    static const unsigned char signature[8] = {0x89, 'P',  'N',  'G',
+                                               '\r', '\n', 0x1a, '\n'};
+    unsigned char header[13] = {};
+    putBigEndian(header, uint32_t(a_width));
+    putBigEndian(header + 4, uint32_t(a_height));
+    header[8] = 8;  // bits per sample
+    header[9] = 6;  // RGBA
+    static const unsigned char zlibHeader[2] = {0x78, 0xda};
+    unsigned char trailer[4];
+    putBigEndian(trailer, uint32_t(adler));
+
+    // the zlib stream may span any number of IDAT chunks; a chunk per strip
+    // keeps each below the 2^31 byte limit for all practical strip sizes
+    bool written = fwrite(signature, 1, 8, file) == 8 &&
+                   writeChunk(file, "IHDR", header, sizeof(header)) &&
+                   writeChunk(file, "IDAT", zlibHeader, sizeof(zlibHeader));
+    for (int s = 0; written && s < strips; ++s) {
+        written = writeChunk(file, "IDAT", deflated[s].data(),
+                             deflated[s].size());
+    }
+    written = written && writeChunk(file, "IDAT", trailer, sizeof(trailer)) &&
+              writeChunk(file, "IEND", nullptr, 0);
+    return fclose(file) == 0 && written;
+}
+
+#endif // VKFILTER_ZLIB
+
+void writeImage(const std::string &a_fileName, int a_width, int a_height,
+                const unsigned char *a_data)
+{
+    if (uncompressedFormatOf(a_fileName) != notUncompressed) {
+        UncompressedWriter writer(a_fileName, a_width, a_height);
+        writer.writeRegion(0, 0, a_width, a_height, a_data,
+                           4 * size_t(a_width));
+        writer.close();
+        return;
+    }
+    size_t len = a_fileName.size();
+    if (len > 4 && a_fileName.compare(len - 4, 4, ".png") == 0) {
+#ifdef VKFILTER_ZLIB
+        if (writePngStrips(a_fileName, a_width, a_height, a_data)) {
+            return;
+        }
+#endif
+        stbi_write_png(a_fileName.c_str(), a_width, a_height, 4, a_data,
+                       a_width * 4);
+    }
+    else {
+        stbi_write_jpg(a_fileName.c_str(), a_width, a_height, 4, a_data, 100);
+    }
+}
+
+CodecPool::CodecPool(int a_threads)
+{
+    int count = a_threads > 0 ? a_threads
+                              : int(std::thread::hardware_concurrency());
+    count = std::max(count, 1);
+    for (int i = 0; i < count; ++i) {
+        workers.push_back(std::thread(&CodecPool::work, this));
+    }
+}
+
+CodecPool::~CodecPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (size_t i = 0; i < workers.size(); ++i) {
+        workers[i].join();
+    }
+}
+
+void CodecPool::work()
+{
+    for (;;) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [this]() { return stopping || !jobs.empty(); });
+            if (jobs.empty()) {
+                return;
+            }
+            job = jobs.front();
+            jobs.pop_front();
+        }
+        job();
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef CODEC_HPP
+#define CODEC_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Writes 8-bit RGBA: uncompressed for the extensions of uncompressed.hpp,
+// PNG when the name ends in .png and JPEG (quality 100) otherwise. Built
+// with zlib (VKFILTER_ZLIB), PNGs are deflated in strips of rows on OpenMP
+// threads, each an independent deflate stream ended on a byte boundary, so
+// one large image no longer encodes on a single core; PNGs written at once
+// split the OpenMP threads between them. JPEG has no such split with
+// stb_image_write and is encoded whole.
+void writeImage(const std::string &a_fileName, int a_width, int a_height,
+                const unsigned char *a_data);
+
+// Worker threads that decode and encode images next to the thread feeding
+// the GPU. Jobs run in submission order as workers free up; their results
+// and exceptions come back through the returned future.
+class CodecPool {
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex lock;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    CodecPool(const CodecPool &);
+    CodecPool &operator=(const CodecPool &);
+
+    void work();
+
+public:
+    // a_threads workers, 0: one per core.
+    explicit CodecPool(int a_threads);
+    // Finishes the queued jobs, then joins the workers.
+    ~CodecPool();
+
+    int size() const { return int(workers.size()); }
+
+    template <class Job>
+    std::future<typename std::result_of<Job()>::type> submit(Job a_job)
+    {
+        typedef typename std::result_of<Job()>::type Result;
+        std::shared_ptr<std::packaged_task<Result()>> task =
+            std::make_shared<std::packaged_task<Result()>>(a_job);
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            jobs.push_back([task]() { (*task)(); });
+        }
+        wake.notify_one();
+        return task->get_future();
+    }
+};
+
+#endif // CODEC_HPP
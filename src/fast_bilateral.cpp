@@ -0,0 +1,81 @@
+#include "fast_bilateral.hpp"
+#include "cmath"
+
+void FastBilateralFilter::buildSpatialTable()
+{
+    const int radius = params.radius;
+    const int side = 2 * radius + 1;
+    spatialWeights.resize(side * side);
+    for (int dy = -radius; dy <= radius; ++dy) {
+        for (int dx = -radius; dx <= radius; ++dx) {
+            spatialWeights[side * (dy + radius) + dx + radius] =
+                exp(-(dy * dy + dx * dx) * 1.f /
+                    (2 * pow(params.sigmaSpatial, 2)));
+        }
+    }
+}
+
+void FastBilateralFilter::buildRangeTable()
+{
+    rangeWeights.resize(RANGE_LUT_SIZE + 1);
+    for (int i = 0; i <= RANGE_LUT_SIZE; ++i) {
+        float diff = i * RANGE_LUT_MAX / RANGE_LUT_SIZE;
+        rangeWeights[i] =
+            exp(-diff * diff * 1.f / (2 * pow(params.sigmaRange, 2)));
+    }
+}
+
+float FastBilateralFilter::rangeWeight(float diff) const
+{
+    diff = fabsf(diff);
+    if (diff >= RANGE_LUT_MAX) {
+        return exp(-diff * diff * 1.f / (2 * pow(params.sigmaRange, 2)));
+    }
+    return rangeWeights[int(diff * (RANGE_LUT_SIZE / RANGE_LUT_MAX) + 0.5f)];
+}
+
+void FastBilateralFilter::run()
+{
+    buildSpatialTable();
+    buildRangeTable();
+    int i;
+#pragma omp parallel for num_threads(threads) schedule(static)
+    for (i = 0; i < int(height); ++i) {
+        for (unsigned int j = 0; j < width; ++j) {
+            newColor(i, j);
+        }
+    }
+    newImage.copyAlpha(oldImage);
+}
+
+// Writes the filtered RGB of (row, column). Neighbours outside the image are
+// skipped by clamping the window instead of testing every sample.
+void FastBilateralFilter::newColor(unsigned int row, unsigned int column)
+{
+    const int radius = params.radius;
+    const int side = 2 * radius + 1;
+    const int jMin = int(row) - radius < 0 ? -int(row) : -radius;
+    const int jMax = int(row) + radius >= int(height)
+                         ? int(height) - 1 - int(row)
+                         : radius;
+    const int kMin = int(column) - radius < 0 ? -int(column) : -radius;
+    const int kMax = int(column) + radius >= int(width)
+                         ? int(width) - 1 - int(column)
+                         : radius;
+    for (int c = 0; c < 3; ++c) {
+        const float center = oldImage.row(c, row)[column];
+        float sum = 0.0f;
+        float norm = 0.0f;
+        for (int j = jMin; j <= jMax; ++j) {
+            const float *spatialRow =
+                &spatialWeights[side * (j + radius) + radius];
+            const float *src = oldImage.row(c, row + j) + column;
+            for (int k = kMin; k <= kMax; ++k) {
+                float weight = spatialRow[k] * rangeWeight(src[k] - center);
+                sum += weight * src[k];
+                norm += weight;
+            }
+        }
+        newImage.row(c, row)[column] = sum / norm;
+    }
+}
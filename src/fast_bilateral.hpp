@@ -0,0 +1,47 @@
+#ifndef FAST_BILATERAL_HPP
+#define FAST_BILATERAL_HPP
+
+#include <vector>
+#include "bilateral.hpp"
+
+// Number of bins of the range-weight lookup table and the largest intensity
+// difference it covers. Differences above RANGE_LUT_MAX fall back to exp().
+#define RANGE_LUT_SIZE 4096
+#define RANGE_LUT_MAX 1.0f
+
+// Same filter as BilateralFilter, but the spatial term is taken from a
+// (2 * radius + 1)^2 table and the range term from a lookup table, so the
+// inner loop is only table lookups and multiply-adds.
+class FastBilateralFilter {
+    unsigned int width;
+    unsigned int height;
+    int threads;
+    BilateralParams params;
+
+    std::vector<float> spatialWeights;
+    std::vector<float> rangeWeights;
+
+    void buildSpatialTable();
+    void buildRangeTable();
+    float rangeWeight(float) const;
+
+public:
+    const PlanarImage &oldImage;
+    PlanarImage &newImage;
+    FastBilateralFilter(const PlanarImage &oldIm, PlanarImage &newIm,
+                        const BilateralParams &params_)
+        : width(oldIm.width()),
+          height(oldIm.height()),
+          threads(omp_get_max_threads()),
+          params(params_),
+          oldImage(oldIm),
+          newImage(newIm){};
+    void setThreads(int threads_)
+    {
+        threads = threads_ > 0 ? threads_ : omp_get_max_threads();
+    }
+    void run();
+    void newColor(unsigned int, unsigned int);
+};
+
+#endif // FAST_BILATERAL_HPP
@@ -0,0 +1,303 @@
+#include "filter_params.hpp"
+#include <errno.h>
+#include <float.h>
+#include <limits.h>
+#include <string.h>
+#include <cstdlib>
+#include <iostream>
+
+void printUsage(const char *a_program)
+{
+    std::cout
+        << "usage: " << a_program << " [options]\n"
+        << "  -i, --input <file>      image to filter\n"
+        << "  -o, --output <file>     result, .png, .jpg, .bmp, .ppm, .pam\n"
+        << "                          or .raw\n"
+        << "  --batch <dir|list>      filter every image of a directory or\n"
+        << "                          list file (gpu only)\n"
+        << "  --out-dir <dir>         results of --batch\n"
+        << "  --out-ext <ext>         format of --batch results: png | jpg |\n"
+        << "                          bmp | ppm | pam | raw\n"
+        << "  --profile <file>        GPU: append per-image phase times to\n"
+        << "                          a CSV file\n"
+        << "  --pipeline-cache <dir>  GPU pipeline cache directory, off to\n"
+        << "                          disable; default ~/.cache/vulkan_filter\n"
+        << "  --mode <m>              gpu | cpu | cpu-fast | cpu-simd | bench\n"
+        << "  --filter <f>            bilateral | nlm\n"
+        << "  --storage <s>           buf | img (gpu only)\n"
+        << "  --format <f>            rgba32f | rgba16f | rgba8, GPU pixel\n"
+        << "                          storage\n"
+        << "  --threads <n>           CPU threads, 0 = all cores\n"
+        << "  --workgroup <n>         GPU workgroup size in x and y\n"
+        << "  --in-flight <n>         GPU images in flight at once\n"
+        << "  --codec-threads <n>     GPU: images decoded and encoded at\n"
+        << "                          once, 0 = all cores\n"
+        << "  --transfer-queue <b>    on | off, GPU copies on a dedicated\n"
+        << "                          transfer queue when available\n"
+        << "  --gpu-convert <b>       on | off, GPU buffers take RGBA8 and\n"
+        << "                          convert in compute passes\n"
+        << "  --tile-budget <MiB>     GPU buffer memory, bigger images are\n"
+        << "                          split into tiles; 0 = half of VRAM\n"
+        << "  --radius <r>            window radius of the chosen filter\n"
+        << "  --sigma-s <v>           bilateral spatial sigma\n"
+        << "  --sigma-r <v>           bilateral range sigma\n"
+        << "  --patch <p>             NLM patch half-size\n"
+        << "  --sigma <v>             NLM noise sigma\n"
+        << "  --h <v>                 NLM filtering strength\n"
+        << "  --kernel <k>            NLM kernel: direct | tiled | integral\n";
+}
+
+// a_value as a whole decimal integer of at least a_min into a_out.
+static bool parseInt(const char *a_option, const char *a_value, int a_min,
+                     int &a_out)
+{
+    char *end = nullptr;
+    errno = 0;
+    const long value = strtol(a_value, &end, 10);
+    if (end == a_value || *end != '\0' || errno == ERANGE ||
+        value < a_min || value > INT_MAX) {
+        std::cerr << a_option << " takes an integer >= " << a_min
+                  << ", got " << a_value << std::endl;
+        return false;
+    }
+    a_out = int(value);
+    return true;
+}
+
+// a_value as a number a float can hold into a_out, above 0 when a_positive
+// or at least 0 otherwise.
+static bool parseFloat(const char *a_option, const char *a_value,
+                       bool a_positive, float &a_out)
+{
+    char *end = nullptr;
+    errno = 0;
+    const double value = strtod(a_value, &end);
+    if (end == a_value || *end != '\0' || errno == ERANGE ||
+        !(value <= FLT_MAX) || value < 0 || (a_positive && value == 0)) {
+        std::cerr << a_option << " takes a number "
+                  << (a_positive ? "> 0" : ">= 0") << ", got " << a_value
+                  << std::endl;
+        return false;
+    }
+    a_out = float(value);
+    return true;
+}
+
+parseResult parseCommandLine(int argc, char **argv, FilterParams &a_params)
+{
+    // --radius belongs to whichever filter is selected, which may come later
+    // on the command line, so it is applied after the loop.
+    int radius = -1;
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            printUsage(argv[0]);
+            return parseHelp;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "missing value for " << arg << std::endl;
+            printUsage(argv[0]);
+            return parseFailed;
+        }
+        const char *value = argv[++i];
+
+        if (strcmp(arg, "-i") == 0 || strcmp(arg, "--input") == 0) {
+            a_params.input = value;
+        }
+        else if (strcmp(arg, "-o") == 0 || strcmp(arg, "--output") == 0) {
+            a_params.output = value;
+        }
+        else if (strcmp(arg, "--batch") == 0) {
+            a_params.batch = value;
+        }
+        else if (strcmp(arg, "--profile") == 0) {
+            a_params.profile = value;
+        }
+        else if (strcmp(arg, "--pipeline-cache") == 0) {
+            a_params.pipelineCache = value;
+        }
+        else if (strcmp(arg, "--out-dir") == 0) {
+            a_params.outputDir = value;
+        }
+        else if (strcmp(arg, "--out-ext") == 0) {
+            a_params.outputExt = value;
+        }
+        else if (strcmp(arg, "--mode") == 0) {
+            if (strcmp(value, "gpu") == 0) {
+                a_params.runMode = gpu;
+            }
+            else if (strcmp(value, "cpu") == 0) {
+                a_params.runMode = cpu;
+            }
+            else if (strcmp(value, "cpu-fast") == 0) {
+                a_params.runMode = cpuFast;
+            }
+            else if (strcmp(value, "cpu-simd") == 0) {
+                a_params.runMode = cpuSimd;
+            }
+            else if (strcmp(value, "bench") == 0) {
+                a_params.runMode = cpuBench;
+            }
+            else {
+                std::cerr << "unknown mode " << value << std::endl;
+                return parseFailed;
+            }
+        }
+        else if (strcmp(arg, "--filter") == 0) {
+            if (strcmp(value, "bilateral") == 0) {
+                a_params.filter = bilateral;
+            }
+            else if (strcmp(value, "nlm") == 0) {
+                a_params.filter = nlm;
+            }
+            else {
+                std::cerr << "unknown filter " << value << std::endl;
+                return parseFailed;
+            }
+        }
+        else if (strcmp(arg, "--storage") == 0) {
+            if (strcmp(value, "buf") == 0) {
+                a_params.storage = buf;
+            }
+            else if (strcmp(value, "img") == 0) {
+                a_params.storage = img;
+            }
+            else {
+                std::cerr << "unknown storage " << value << std::endl;
+                return parseFailed;
+            }
+        }
+        else if (strcmp(arg, "--format") == 0) {
+            if (strcmp(value, "rgba32f") == 0) {
+                a_params.format = rgba32f;
+            }
+            else if (strcmp(value, "rgba16f") == 0) {
+                a_params.format = rgba16f;
+            }
+            else if (strcmp(value, "rgba8") == 0) {
+                a_params.format = rgba8;
+            }
+            else {
+                std::cerr << "unknown format " << value << std::endl;
+                return parseFailed;
+            }
+        }
+        else if (strcmp(arg, "--threads") == 0) {
+            if (!parseInt(arg, value, 0, a_params.threads)) {
+                return parseFailed;
+            }
+        }
+        else if (strcmp(arg, "--workgroup") == 0) {
+            if (!parseInt(arg, value, 1, a_params.workgroupSize)) {
+                return parseFailed;
+            }
+        }
+        else if (strcmp(arg, "--in-flight") == 0) {
+            if (!parseInt(arg, value, 1, a_params.inFlight)) {
+                return parseFailed;
+            }
+        }
+        else if (strcmp(arg, "--codec-threads") == 0) {
+            if (!parseInt(arg, value, 0, a_params.codecThreads)) {
+                return parseFailed;
+            }
+        }
+        else if (strcmp(arg, "--transfer-queue") == 0) {
+            if (strcmp(value, "on") == 0) {
+                a_params.transferQueue = true;
+            }
+            else if (strcmp(value, "off") == 0) {
+                a_params.transferQueue = false;
+            }
+            else {
+                std::cerr << "--transfer-queue takes on or off" << std::endl;
+                return parseFailed;
+            }
+        }
+        else if (strcmp(arg, "--gpu-convert") == 0) {
+            if (strcmp(value, "on") == 0) {
+                a_params.gpuConvert = true;
+            }
+            else if (strcmp(value, "off") == 0) {
+                a_params.gpuConvert = false;
+            }
+            else {
+                std::cerr << "--gpu-convert takes on or off" << std::endl;
+                return parseFailed;
+            }
+        }
+        else if (strcmp(arg, "--tile-budget") == 0) {
+            if (!parseInt(arg, value, 0, a_params.tileBudget)) {
+                return parseFailed;
+            }
+        }
+        else if (strcmp(arg, "--radius") == 0) {
+            if (!parseInt(arg, value, 0, radius)) {
+                return parseFailed;
+            }
+        }
+        else if (strcmp(arg, "--sigma-s") == 0) {
+            if (!parseFloat(arg, value, true,
+                            a_params.bilateralParams.sigmaSpatial)) {
+                return parseFailed;
+            }
+        }
+        else if (strcmp(arg, "--sigma-r") == 0) {
+            if (!parseFloat(arg, value, true,
+                            a_params.bilateralParams.sigmaRange)) {
+                return parseFailed;
+            }
+        }
+        else if (strcmp(arg, "--patch") == 0) {
+            if (!parseInt(arg, value, 0, a_params.nlmParams.patch)) {
+                return parseFailed;
+            }
+        }
+        else if (strcmp(arg, "--sigma") == 0) {
+            // only subtracted from the distance, 0 is valid
+            if (!parseFloat(arg, value, false, a_params.nlmParams.sigma)) {
+                return parseFailed;
+            }
+        }
+        else if (strcmp(arg, "--h") == 0) {
+            if (!parseFloat(arg, value, true, a_params.nlmParams.h)) {
+                return parseFailed;
+            }
+        }
+        else if (strcmp(arg, "--kernel") == 0) {
+            if (strcmp(value, "direct") == 0) {
+                a_params.nlmParams.kernel = direct;
+            }
+            else if (strcmp(value, "tiled") == 0) {
+                a_params.nlmParams.kernel = tiled;
+            }
+            else if (strcmp(value, "integral") == 0) {
+                a_params.nlmParams.kernel = integral;
+            }
+            else {
+                std::cerr << "unknown kernel " << value << std::endl;
+                return parseFailed;
+            }
+        }
+        else {
+            std::cerr << "unknown option " << arg << std::endl;
+            printUsage(argv[0]);
+            return parseFailed;
+        }
+    }
+
+    if (!a_params.batch.empty() && a_params.runMode != gpu) {
+        std::cerr << "--batch needs --mode gpu" << std::endl;
+        return parseFailed;
+    }
+
+    if (radius >= 0) {
+        if (a_params.filter == bilateral) {
+            a_params.bilateralParams.radius = radius;
+        }
+        else {
+            a_params.nlmParams.radius = radius;
+        }
+    }
+    return parseOk;
+}
@@ -0,0 +1,88 @@
+#ifndef FILTER_PARAMS_HPP
+#define FILTER_PARAMS_HPP
+
+#include <string>
+
+enum mode { cpu, cpuFast, cpuSimd, cpuBench, gpu };
+
+enum storageMode { img, buf };
+
+enum filterType { bilateral, nlm };
+
+// How the GPU stores pixels in its buffers and images; the filters compute
+// in fp32 whatever the format.
+enum pixelFormat { rgba32f, rgba16f, rgba8 };
+
+// direct: nlm.comp, tiled: nlm_tiled.comp, integral: one box-filtered
+// squared-difference image per search offset (CPU and GPU)
+enum nlmKernel { direct, tiled, integral };
+
+// The bilateral shaders' former values; the CPU engine used to run with
+// radius 10 and both sigmas 35 (--radius 10 --sigma-s 35 --sigma-r 35).
+struct BilateralParams {
+    int radius = 5;
+    float sigmaSpatial = 30;  // SYGMA1
+    float sigmaRange = 20;    // SYGMA2
+};
+
+struct NlmParams {
+    int radius = 3;   // search window
+    int patch = 1;    // patch half-size
+    float sigma = 25; // SYGMA, expected noise level
+    float h = 14;     // STEP, filtering strength
+    nlmKernel kernel = direct;
+};
+
+// Everything that used to be picked with #defines in main.cpp, bilateral.hpp
+// and the .comp files. Defaults reproduce the previous hard-coded setup,
+// except that the CPU bilateral now shares the GPU's numbers.
+struct FilterParams {
+    mode runMode = gpu;
+    filterType filter = nlm;
+    storageMode storage = buf;
+    int threads = 0;  // CPU engines, 0 means all cores
+    int workgroupSize = 16;  // GPU, local size in x and y
+    int inFlight = 2;  // GPU buffer path, images submitted ahead of the host
+    // GPU buffer path, threads decoding and encoding images next to the one
+    // feeding the GPU, 0 means all cores
+    int codecThreads = 0;
+    // GPU buffer path, staging copies on a transfer-only queue if the
+    // device has one
+    bool transferQueue = true;
+    // GPU buffer path, MiB of buffers for all slots; larger images are
+    // filtered in overlapping tiles. 0: half of the device-local memory
+    int tileBudget = 0;
+    pixelFormat format = rgba32f;  // GPU storage
+    // GPU buffer path, move RGBA8 between host and device and convert to
+    // and from the storage format in compute passes
+    bool gpuConvert = false;
+    BilateralParams bilateralParams;
+    NlmParams nlmParams;
+    std::string input = "Bathroom_LDR_0001.png";
+    std::string output = "images/filtered.jpg";
+    // gpu only: directory or list file of inputs filtered with one Vulkan
+    // context, results go to outputDir as .<outputExt>
+    std::string batch;
+    std::string outputDir = "images";
+    // png | jpg, or bmp | ppm | pam | raw to skip compression
+    std::string outputExt = "png";
+    // gpu only: CSV file that gets one row of host and GPU phase times
+    // per image appended
+    std::string profile;
+    // gpu only: directory of the on-disk pipeline cache, "off" disables it,
+    // empty means $XDG_CACHE_HOME/vulkan_filter or ~/.cache/vulkan_filter
+    std::string pipelineCache;
+    // Progress, device and timing lines on stdout. Off, libvkfilter writes
+    // nothing there but the cpu-bench table; the executable turns it on.
+    bool verbose = false;
+};
+
+enum parseResult { parseOk, parseHelp, parseFailed };
+
+// Parses argv into a_params. Prints the usage text and returns parseHelp
+// for --help; malformed arguments and numbers out of range are reported on
+// stderr and return parseFailed.
+parseResult parseCommandLine(int argc, char **argv, FilterParams &a_params);
+void printUsage(const char *a_program);
+
+#endif // FILTER_PARAMS_HPP
@@ -0,0 +1,191 @@
+#include "integral_nlm.hpp"
+#include <algorithm>
+#include "cmath"
+
+// Columns handled together by prefixColumns(), so every thread walks
+// contiguous memory down the image.
+#define COLUMN_BLOCK 64
+
+// Samples after which the row and column prefix sums start again from zero.
+// A prefix over a whole row or column of squared differences on the 0..255
+// scale reaches ~1e9 on large images, where a float step is ~100 and the
+// difference of two such sums loses the patch distance; restarted, every
+// stored sum covers at most PREFIX_BLOCK samples whatever the image size.
+// Must match PREFIX_BLOCK in shaders/nlm_integral.glsl.
+#define PREFIX_BLOCK 64
+
+// Block restarts in a prefix a_prefix[0..n] of d[0..n-1]: a_prefix[j] holds
+// the sum of d from the start of j's block, (j - 1) / PREFIX_BLOCK, to j - 1,
+// so the last entry of a block is that block's total.
+static int prefixBlock(int a_j)
+{
+    return std::max(a_j - 1, 0) / PREFIX_BLOCK;
+}
+
+// Sum of d[a_lo..a_end - 1] from the restarted prefix, entries a_stride
+// apart: the two partial sums plus the totals of the blocks in between.
+static float windowSum(const float *a_prefix, size_t a_stride, int a_lo,
+                       int a_end)
+{
+    float sum = a_prefix[a_stride * a_end] - a_prefix[a_stride * a_lo];
+    for (int b = prefixBlock(a_lo); b < prefixBlock(a_end); ++b) {
+        sum += a_prefix[a_stride * (size_t(b + 1) * PREFIX_BLOCK)];
+    }
+    return sum;
+}
+
+void IntegralNlmFilter::run()
+{
+    const int radius = params.radius;
+    rowBox.assign(width * height, 0.0f);
+    colPrefix.assign(width * (height + 1), 0.0f);
+    accum.assign(4 * size_t(width) * height, 0.0f);
+
+    for (int dy = -radius; dy <= radius; ++dy) {
+        for (int dx = -radius; dx <= radius; ++dx) {
+#pragma omp parallel num_threads(threads)
+            {
+                std::vector<float> prefix(width + 1);
+                int i;
+#pragma omp for schedule(static)
+                for (i = 0; i < int(height); ++i) {
+                    boxRow(i, dy, dx, prefix);
+                }
+            }
+            prefixColumns();
+            accumulate(dy, dx);
+        }
+    }
+
+    const size_t planeSize = size_t(width) * height;
+    int i;
+#pragma omp parallel for num_threads(threads) schedule(static)
+    for (i = 0; i < int(height); ++i) {
+        const float *weights = &accum[3 * planeSize + size_t(width) * i];
+        for (int c = 0; c < 3; ++c) {
+            const float *acc = &accum[c * planeSize + size_t(width) * i];
+            float *dst = newImage.row(c, i);
+            for (unsigned int j = 0; j < width; ++j) {
+                dst[j] = acc[j] / weights[j];
+            }
+        }
+    }
+    newImage.copyAlpha(oldImage);
+}
+
+float IntegralNlmFilter::w(float distance) const
+{
+    float maximum = std::max(distance - 2.0f * params.sigma * params.sigma,
+                             0.0f);
+    return exp(-maximum / (params.h * params.h));
+}
+
+// Squared difference of row against its copy shifted by (dy, dx), summed over
+// [column - patch, column + patch] through a prefix sum of the row. Samples
+// whose shifted pixel falls outside the image contribute nothing.
+void IntegralNlmFilter::boxRow(int row, int dy, int dx,
+                               std::vector<float> &prefix)
+{
+    const int patch = params.patch;
+    const int shiftedRow = row + dy;
+    const bool rowInside = shiftedRow >= 0 && shiftedRow < int(height);
+    const float *src[3];
+    const float *shifted[3];
+    for (int c = 0; c < 3; ++c) {
+        src[c] = oldImage.row(c, row);
+        shifted[c] = oldImage.row(c, rowInside ? shiftedRow : 0);
+    }
+
+    float running = 0.0f;
+    prefix[0] = 0.0f;
+    for (int k = 0; k < int(width); ++k) {
+        if (k % PREFIX_BLOCK == 0) {
+            running = 0.0f;
+        }
+        const int shiftedColumn = k + dx;
+        if (rowInside && shiftedColumn >= 0 && shiftedColumn < int(width)) {
+            for (int c = 0; c < 3; ++c) {
+                float diff = (src[c][k] - shifted[c][shiftedColumn]) * 255.0f;
+                running += diff * diff;
+            }
+        }
+        prefix[k + 1] = running;
+    }
+
+    float *box = &rowBox[width * row];
+    for (int k = 0; k < int(width); ++k) {
+        const int lo = std::max(k - patch, 0);
+        const int hi = std::min(k + patch, int(width) - 1);
+        box[k] = windowSum(&prefix[0], 1, lo, hi + 1);
+    }
+}
+
+void IntegralNlmFilter::prefixColumns()
+{
+    int b;
+#pragma omp parallel for num_threads(threads) schedule(static)
+    for (b = 0; b < int(width); b += COLUMN_BLOCK) {
+        const int end = std::min(b + COLUMN_BLOCK, int(width));
+        for (int k = b; k < end; ++k) {
+            colPrefix[k] = 0.0f;
+        }
+        for (unsigned int i = 0; i < height; ++i) {
+            const float *prev = &colPrefix[width * i];
+            const float *box = &rowBox[width * i];
+            float *cur = &colPrefix[width * (i + 1)];
+            if (i % PREFIX_BLOCK == 0) {
+                for (int k = b; k < end; ++k) {
+                    cur[k] = box[k];
+                }
+                continue;
+            }
+            for (int k = b; k < end; ++k) {
+                cur[k] = prev[k] + box[k];
+            }
+        }
+    }
+}
+
+// Patch distance of every pixel to its neighbour at (dy, dx) from two column
+// prefix lookups, and the resulting weighted colour added to accum. The
+// divisor counts only the patch samples inside the image for both pixels.
+void IntegralNlmFilter::accumulate(int dy, int dx)
+{
+    const int patch = params.patch;
+    const size_t planeSize = size_t(width) * height;
+    int i;
+#pragma omp parallel for num_threads(threads) schedule(static)
+    for (i = 0; i < int(height); ++i) {
+        const int shiftedRow = i + dy;
+        if (shiftedRow < 0 || shiftedRow >= int(height)) {
+            continue;
+        }
+        const int lo = std::max(i - patch, 0);
+        const int hi = std::min(i + patch, int(height) - 1);
+        const int rows =
+            std::min(patch, std::min(int(height) - 1 - i,
+                                     int(height) - 1 - shiftedRow)) -
+            std::max(-patch, std::max(-i, -shiftedRow)) + 1;
+        for (int k = 0; k < int(width); ++k) {
+            const int shiftedColumn = k + dx;
+            if (shiftedColumn < 0 || shiftedColumn >= int(width)) {
+                continue;
+            }
+            const int columns =
+                std::min(patch, std::min(int(width) - 1 - k,
+                                         int(width) - 1 - shiftedColumn)) -
+                std::max(-patch, std::max(-k, -shiftedColumn)) + 1;
+            const float distance =
+                windowSum(&colPrefix[k], width, lo, hi + 1) /
+                (3.0f * float(rows * columns));
+            const float weight = w(distance);
+
+            float *acc = &accum[size_t(width) * i + k];
+            for (int c = 0; c < 3; ++c) {
+                acc[c * planeSize] +=
+                    weight * oldImage.row(c, shiftedRow)[shiftedColumn];
+            }
+            acc[3 * planeSize] += weight;
+        }
+    }
+}
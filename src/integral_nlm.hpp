@@ -0,0 +1,60 @@
+#ifndef INTEGRAL_NLM_HPP
+#define INTEGRAL_NLM_HPP
+
+#include <omp.h>
+#include <vector>
+#include "filter_params.hpp"
+#include "planar_image.hpp"
+
+// NLM in the style of Darbon et al.: for every offset (dy, dx) of the search
+// window the squared colour difference between the image and its shifted copy
+// is turned into prefix sums along rows and then along columns, so the patch
+// distance of each pixel costs four lookups whatever the patch size.
+//
+// The distance is the plain mean of squared differences over the patch and
+// the three channels (0..255 scale). nlm.comp weights every sample by a
+// running counter, which cannot be expressed with prefix sums, so results
+// differ slightly from the direct kernel. w() is the same as in nlm.comp.
+//
+// Expected tolerance against NlmFilter, on the 0..255 scale: with default
+// parameters and noise of +-0.15 a mean difference of ~0.6 and at most ~14
+// where the weighting differs most, none where every distance is below
+// 2 * sigma^2. The prefix sums restart every PREFIX_BLOCK samples, so their
+// fp32 rounding stays below 1e-3 against a double evaluation of the same
+// definition whatever the image size.
+class IntegralNlmFilter {
+    unsigned int width;
+    unsigned int height;
+    int threads;
+    NlmParams params;
+
+    std::vector<float> rowBox;     // patch sums along rows, width * height
+    // prefix sums of rowBox down the columns, restarted every
+    // PREFIX_BLOCK rows, (height + 1) rows
+    std::vector<float> colPrefix;
+    std::vector<float> accum;      // planes of weighted r, g, b and weights
+
+    void boxRow(int, int, int, std::vector<float> &);
+    void prefixColumns();
+    void accumulate(int, int);
+    float w(float) const;
+
+public:
+    const PlanarImage &oldImage;
+    PlanarImage &newImage;
+    IntegralNlmFilter(const PlanarImage &oldIm, PlanarImage &newIm,
+                      const NlmParams &params_)
+        : width(oldIm.width()),
+          height(oldIm.height()),
+          threads(omp_get_max_threads()),
+          params(params_),
+          oldImage(oldIm),
+          newImage(newIm){};
+    void setThreads(int threads_)
+    {
+        threads = threads_ > 0 ? threads_ : omp_get_max_threads();
+    }
+    void run();
+};
+
+#endif // INTEGRAL_NLM_HPP
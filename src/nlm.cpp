@@ -0,0 +1,190 @@
+#include "nlm.hpp"
+#include <algorithm>
+#include "cmath"
+
+void NlmFilter::run()
+{
+    const int side = 2 * params.patch + 1;
+    buildCoefficients(side * side, coefficients);
+
+    // pixels whose search window and patches lie inside the image
+    const int margin = params.radius + params.patch;
+    const int interiorBegin = margin;
+    const int interiorEnd = int(width) - margin;
+
+    const int tilesX = (int(width) + NLM_TILE - 1) / NLM_TILE;
+    const int tilesY = (int(height) + NLM_TILE - 1) / NLM_TILE;
+#pragma omp parallel num_threads(threads)
+    {
+        // coefficients of clipped patches at the image border
+        std::vector<float> scratch;
+        int t;
+#pragma omp for schedule(dynamic)
+        for (t = 0; t < tilesX * tilesY; ++t) {
+            const int rowEnd = std::min((t / tilesX + 1) * NLM_TILE,
+                                        int(height));
+            const int columnEnd = std::min((t % tilesX + 1) * NLM_TILE,
+                                           int(width));
+            const int columnBegin = (t % tilesX) * NLM_TILE;
+            for (int i = (t / tilesX) * NLM_TILE; i < rowEnd; ++i) {
+                int blockBegin = columnEnd;
+                int blockEnd = columnEnd;
+                if (i >= margin && i + margin < int(height)) {
+                    blockBegin = std::max(columnBegin, interiorBegin);
+                    blockEnd = std::min(columnEnd, interiorEnd);
+                }
+                if (blockBegin < blockEnd) {
+                    interiorBlock(i, blockBegin, blockEnd - blockBegin);
+                }
+                for (int j = columnBegin; j < columnEnd; ++j) {
+                    if (j < blockBegin || j >= blockEnd) {
+                        newColor(i, j, scratch);
+                    }
+                }
+            }
+        }
+    }
+    newImage.copyAlpha(oldImage);
+}
+
+// The m-th valid sample of channel c is the (c * n + m + 1)-th increment of
+// counter in nlm.comp, where n is the number of valid samples; the table is
+// laid out in that order.
+void NlmFilter::buildCoefficients(int n, std::vector<float> &table) const
+{
+    table.resize(3 * n);
+    for (int i = 0; i < 3 * n; ++i) {
+        float counter = float(i + 1);
+        table[i] = 1.f / (3.f * counter * counter);
+    }
+}
+
+// Patch distance as in nlm.comp. Samples outside the image for either pixel
+// are skipped; those left always form a rectangle of offsets.
+float NlmFilter::d(int row1, int column1, int row2, int column2,
+                   std::vector<float> &scratch) const
+{
+    const int patch = params.patch;
+    const int jMin = std::max(-patch, std::max(-row1, -row2));
+    const int jMax = std::min(
+        patch, std::min(int(height) - 1 - row1, int(height) - 1 - row2));
+    const int kMin = std::max(-patch, std::max(-column1, -column2));
+    const int kMax = std::min(
+        patch, std::min(int(width) - 1 - column1, int(width) - 1 - column2));
+    const int columns = kMax - kMin + 1;
+    const int n = (jMax - jMin + 1) * columns;
+
+    const float *coef = coefficients.data();
+    if (3 * n != int(coefficients.size())) {
+        buildCoefficients(n, scratch);
+        coef = scratch.data();
+    }
+
+    float resultValue = 0.0f;
+    for (int c = 0; c < 3; ++c) {
+        float acc = 0.0f;
+        for (int j = jMin; j <= jMax; ++j) {  // row
+            const float *p1 = oldImage.row(c, row1 + j) + column1 + kMin;
+            const float *p2 = oldImage.row(c, row2 + j) + column2 + kMin;
+#pragma omp simd reduction(+ : acc)
+            for (int k = 0; k < columns; ++k) {  // num in row
+                float diff = (p1[k] - p2[k]) * 255.0f;
+                acc += diff * diff * coef[k];
+            }
+            coef += columns;
+        }
+        resultValue += acc;
+    }
+    return resultValue;
+}
+
+float NlmFilter::w(float distance) const
+{
+    float maximum = std::max(distance - 2.0f * params.sigma * params.sigma,
+                             0.0f);
+    return 1.f / exp(maximum * (1.f / (params.h * params.h)));
+}
+
+// Single pass over the search window; neighbours outside the image are
+// skipped by clamping the window.
+void NlmFilter::newColor(unsigned int row, unsigned int column,
+                         std::vector<float> &scratch)
+{
+    const int radius = params.radius;
+    const int jMin = std::max(-radius, -int(row));
+    const int jMax = std::min(radius, int(height) - 1 - int(row));
+    const int kMin = std::max(-radius, -int(column));
+    const int kMax = std::min(radius, int(width) - 1 - int(column));
+
+    float sum[3] = {0.0f, 0.0f, 0.0f};
+    float norm = 0.0f;
+    for (int j = jMin; j <= jMax; ++j) {
+        for (int k = kMin; k <= kMax; ++k) {
+            const int row2 = int(row) + j;
+            const int column2 = int(column) + k;
+            float weight = w(d(row, column, row2, column2, scratch));
+            for (int c = 0; c < 3; ++c) {
+                sum[c] += weight * oldImage.row(c, row2)[column2];
+            }
+            norm += weight;
+        }
+    }
+    for (int c = 0; c < 3; ++c) {
+        newImage.row(c, row)[column] = sum[c] / norm;
+    }
+}
+
+// newColor() for a run of count <= NLM_TILE pixels of one row, all far
+// enough from the border that every patch is complete. For each search
+// offset the patch distances of the whole run are built together, so the
+// inner loop runs over neighbouring pixels in a plane row and vectorises.
+void NlmFilter::interiorBlock(int row, int column, int count)
+{
+    const int radius = params.radius;
+    const int patch = params.patch;
+
+    float sum[3][NLM_TILE] = {};
+    float norm[NLM_TILE] = {};
+    for (int dy = -radius; dy <= radius; ++dy) {
+        for (int dx = -radius; dx <= radius; ++dx) {
+            float distance[NLM_TILE] = {};
+            const float *coef = coefficients.data();
+            for (int c = 0; c < 3; ++c) {
+                float acc[NLM_TILE] = {};
+                for (int j = -patch; j <= patch; ++j) {  // row
+                    const float *p1 =
+                        oldImage.row(c, row + j) + column - patch;
+                    const float *p2 =
+                        oldImage.row(c, row + dy + j) + column + dx - patch;
+                    for (int k = 0; k <= 2 * patch; ++k) {  // num in row
+                        const float weight = *coef++;
+#pragma omp simd
+                        for (int l = 0; l < count; ++l) {
+                            float diff = (p1[k + l] - p2[k + l]) * 255.0f;
+                            acc[l] += diff * diff * weight;
+                        }
+                    }
+                }
+                for (int l = 0; l < count; ++l) {
+                    distance[l] += acc[l];
+                }
+            }
+
+            for (int l = 0; l < count; ++l) {
+                const float weight = w(distance[l]);
+                for (int c = 0; c < 3; ++c) {
+                    sum[c][l] +=
+                        weight * oldImage.row(c, row + dy)[column + dx + l];
+                }
+                norm[l] += weight;
+            }
+        }
+    }
+
+    for (int c = 0; c < 3; ++c) {
+        float *dst = newImage.row(c, row) + column;
+        for (int l = 0; l < count; ++l) {
+            dst[l] = sum[c][l] / norm[l];
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef NLM_HPP
+#define NLM_HPP
+
+#include <omp.h>
+#include <vector>
+#include "filter_params.hpp"
+#include "planar_image.hpp"
+
+// Side of the square blocks the image is split into, so the search windows
+// of neighbouring pixels stay in cache while a thread works on its block.
+#define NLM_TILE 32
+
+// CPU port of shaders/nlm.comp with the same d() and w(). The running
+// counter of d() (channel by channel, then row by row over the valid patch
+// samples) is turned into a per-sample coefficient table, so each patch row
+// of a channel plane is one vectorisable multiply-add loop.
+class NlmFilter {
+    unsigned int width;
+    unsigned int height;
+    int threads;
+    NlmParams params;
+
+    // 1 / (3 * counter^2) for every sample and channel of a full patch
+    std::vector<float> coefficients;
+
+    void buildCoefficients(int, std::vector<float> &) const;
+    float d(int, int, int, int, std::vector<float> &) const;
+    float w(float) const;
+    void interiorBlock(int, int, int);
+
+public:
+    const PlanarImage &oldImage;
+    PlanarImage &newImage;
+    NlmFilter(const PlanarImage &oldIm, PlanarImage &newIm,
+              const NlmParams &params_)
+        : width(oldIm.width()),
+          height(oldIm.height()),
+          threads(omp_get_max_threads()),
+          params(params_),
+          oldImage(oldIm),
+          newImage(newIm){};
+    void setThreads(int threads_)
+    {
+        threads = threads_ > 0 ? threads_ : omp_get_max_threads();
+    }
+    void run();
+    void newColor(unsigned int, unsigned int, std::vector<float> &);
+};
+
+#endif // NLM_HPP
@@ -0,0 +1,189 @@
+#include "pixel_format.hpp"
+#include <omp.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// IEEE binary16 with round to nearest even; overflow goes to infinity and
+// values below the smallest subnormal to zero.
+static uint16_t floatToHalf(float a_value)
+{
+    uint32_t bits;
+    memcpy(&bits, &a_value, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const uint32_t biased = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+    if (biased == 0xff) {
+        return uint16_t(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    }
+    const int exponent = int(biased) - 127 + 15;
+    if (exponent >= 31) {
+        return uint16_t(sign | 0x7c00);
+    }
+    if (exponent <= 0) {
+        if (exponent < -10) {
+            return uint16_t(sign);
+        }
+        mantissa |= 0x800000;
+        const int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        const uint32_t rest = mantissa & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1))) {
+            ++half;
+        }
+        return uint16_t(sign | half);
+    }
+    // a carry out of the mantissa correctly bumps the exponent
+    uint32_t half = (uint32_t(exponent) << 10) | (mantissa >> 13);
+    const uint32_t rest = mantissa & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+        ++half;
+    }
+    return uint16_t(sign | half);
+}
+
+static float halfToFloat(uint16_t a_half)
+{
+    const uint32_t sign = uint32_t(a_half & 0x8000) << 16;
+    const uint32_t exponent = (a_half >> 10) & 0x1f;
+    const uint32_t mantissa = a_half & 0x3ff;
+    if (exponent == 0) {
+        const float value = std::ldexp(float(mantissa), -24);
+        return sign ? -value : value;
+    }
+    uint32_t bits;
+    if (exponent == 0x1f) {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    }
+    else {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+size_t pixelBytes(pixelFormat a_format)
+{
+    switch (a_format) {
+    case rgba16f:
+        return 4 * sizeof(uint16_t);
+    case rgba8:
+        return 4;
+    default:
+        return 4 * sizeof(float);
+    }
+}
+
+void packPixels(const float *a_rgba, size_t a_count, pixelFormat a_format,
+                void *a_dst)
+{
+    const size_t values = 4 * a_count;
+    if (a_format == rgba16f) {
+        uint16_t *dst = (uint16_t *)a_dst;
+        for (size_t i = 0; i < values; ++i) {
+            dst[i] = floatToHalf(a_rgba[i]);
+        }
+    }
+    else if (a_format == rgba8) {
+        unsigned char *dst = (unsigned char *)a_dst;
+        for (size_t i = 0; i < values; ++i) {
+            const float v = std::min(std::max(a_rgba[i], 0.0f), 1.0f);
+            dst[i] = (unsigned char)(255.0f * v + 0.5f);
+        }
+    }
+    else {
+        memcpy(a_dst, a_rgba, values * sizeof(float));
+    }
+}
+
+void unpackToRgba8(const void *a_src, size_t a_count, pixelFormat a_format,
+                   unsigned char *a_dst)
+{
+    const size_t values = 4 * a_count;
+    if (a_format == rgba16f) {
+        const uint16_t *src = (const uint16_t *)a_src;
+        for (size_t i = 0; i < values; ++i) {
+            const float v =
+                std::min(std::max(0.0f, halfToFloat(src[i])), 1.0f);
+            a_dst[i] = (unsigned char)(255.0f * v);
+        }
+    }
+    else if (a_format == rgba8) {
+        memcpy(a_dst, a_src, values);
+    }
+    else {
+        // clamped so the loop has no undefined conversions and vectorizes;
+        // values in [0, 1] truncate as before, NaN becomes 0
+        const float *src = (const float *)a_src;
+#pragma omp simd
+        for (size_t i = 0; i < values; ++i) {
+            const float v = std::min(std::max(0.0f, src[i]), 1.0f);
+            a_dst[i] = (unsigned char)(255.0f * v);
+        }
+    }
+}
+
+void unpackRowsToRgba8(const void *a_src, size_t a_srcStride,
+                       size_t a_width, size_t a_height, pixelFormat a_format,
+                       unsigned char *a_dst, size_t a_dstStride,
+                       int a_threads)
+{
+    const int threads = a_threads > 0 ? a_threads : omp_get_max_threads();
+    long i;
+#pragma omp parallel for num_threads(threads) schedule(static)
+    for (i = 0; i < long(a_height); ++i) {
+        unpackToRgba8((const char *)a_src + a_srcStride * i, a_width,
+                      a_format, a_dst + a_dstStride * i);
+    }
+}
+
+void rgba8ToLinear(const unsigned char *a_src, size_t a_count, float *a_rgba)
+{
+    struct Table {
+        float gamma[256];
+        Table()
+        {
+            for (int c = 0; c < 256; ++c) {
+                gamma[c] = std::pow(c / 255.0f, 2.2f);
+            }
+        }
+    };
+    static const Table table;
+    for (size_t i = 0; i < a_count; ++i) {
+        a_rgba[4 * i + 0] = table.gamma[a_src[4 * i + 0]];
+        a_rgba[4 * i + 1] = table.gamma[a_src[4 * i + 1]];
+        a_rgba[4 * i + 2] = table.gamma[a_src[4 * i + 2]];
+        a_rgba[4 * i + 3] = a_src[4 * i + 3] / 255.0f;
+    }
+}
+
+void rgba8ToFloat(const unsigned char *a_src, size_t a_count, float *a_rgba)
+{
+    for (size_t i = 0; i < 4 * a_count; ++i) {
+        a_rgba[i] = a_src[i] / 255.0f;
+    }
+}
+
+void rgba16ToLinear(const uint16_t *a_src, size_t a_count, float *a_rgba)
+{
+    struct Table {
+        std::vector<float> gamma;
+        Table() : gamma(65536)
+        {
+            for (int c = 0; c < 65536; ++c) {
+                gamma[c] = std::pow(c / 65535.0f, 2.2f);
+            }
+        }
+    };
+    static const Table table;
+    for (size_t i = 0; i < a_count; ++i) {
+        a_rgba[4 * i + 0] = table.gamma[a_src[4 * i + 0]];
+        a_rgba[4 * i + 1] = table.gamma[a_src[4 * i + 1]];
+        a_rgba[4 * i + 2] = table.gamma[a_src[4 * i + 2]];
+        a_rgba[4 * i + 3] = a_src[4 * i + 3] / 65535.0f;
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef PIXEL_FORMAT_HPP
+#define PIXEL_FORMAT_HPP
+
+#include <stdint.h>
+#include <cstddef>
+#include "filter_params.hpp"
+
+// Bytes of one pixel in a_format: 16, 8 or 4.
+size_t pixelBytes(pixelFormat a_format);
+
+// Converts a_count interleaved RGBA float pixels to a_format, the layout
+// shaders/pixel_format.glsl reads: RGBA8 is rounded and clamped like
+// unpackUnorm4x8 expects, RGBA16F rounded to nearest even.
+void packPixels(const float *a_rgba, size_t a_count, pixelFormat a_format,
+                void *a_dst);
+
+// Converts a_count pixels of a_format to 8-bit RGBA for writeImage(). Float
+// formats are clamped to [0, 1] (NaN to 0), scaled by 255 and truncated
+// as before; RGBA8 is copied.
+void unpackToRgba8(const void *a_src, size_t a_count, pixelFormat a_format,
+                   unsigned char *a_dst);
+
+// unpackToRgba8() over a_height rows of a_width pixels, a_srcStride and
+// a_dstStride bytes apart, split across a_threads OpenMP threads (0: all
+// cores). The readback of the GPU path converts straight out of mapped
+// memory with it.
+void unpackRowsToRgba8(const void *a_src, size_t a_srcStride,
+                       size_t a_width, size_t a_height, pixelFormat a_format,
+                       unsigned char *a_dst, size_t a_dstStride,
+                       int a_threads);
+
+// Converts a_count 8-bit RGBA pixels to linear floats the way stbi_loadf()
+// does: colour through a 2.2 gamma, alpha scaled by 1/255. Used for 8-bit
+// raw frames.
+void rgba8ToLinear(const unsigned char *a_src, size_t a_count, float *a_rgba);
+
+// Scales a_count 8-bit RGBA pixels by 1/255 without gamma. Used for caller
+// memory handed to vkfilter::Context, which is filtered in its own encoding.
+void rgba8ToFloat(const unsigned char *a_src, size_t a_count, float *a_rgba);
+
+// rgba8ToLinear() for 16-bit samples, as in raw frame dumps.
+void rgba16ToLinear(const uint16_t *a_src, size_t a_count, float *a_rgba);
+
+#endif // PIXEL_FORMAT_HPP
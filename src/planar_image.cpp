@@ -0,0 +1,50 @@
+#include "planar_image.hpp"
+#include <stdint.h>
+#include <string.h>
+
+PlanarImage::PlanarImage(unsigned int width_, unsigned int height_)
+    : imageWidth(width_), imageHeight(height_)
+{
+    const size_t alignFloats = PLANAR_ALIGNMENT / sizeof(float);
+    rowStride = (size_t(width_) + alignFloats - 1) / alignFloats * alignFloats;
+    storage.assign(rowStride * height_ * channels + alignFloats, 0.0f);
+
+    const uintptr_t address = reinterpret_cast<uintptr_t>(storage.data());
+    const uintptr_t misalignment = address % PLANAR_ALIGNMENT;
+    base = storage.data() +
+           (misalignment ? (PLANAR_ALIGNMENT - misalignment) / sizeof(float)
+                         : 0);
+}
+
+void PlanarImage::fromInterleaved(const float *rgba)
+{
+    for (unsigned int y = 0; y < imageHeight; ++y) {
+        const float *src = &rgba[4 * size_t(imageWidth) * y];
+        for (int c = 0; c < channels; ++c) {
+            float *dst = row(c, y);
+            for (unsigned int x = 0; x < imageWidth; ++x) {
+                dst[x] = src[4 * x + c];
+            }
+        }
+    }
+}
+
+void PlanarImage::toInterleaved(float *rgba) const
+{
+    for (unsigned int y = 0; y < imageHeight; ++y) {
+        float *dst = &rgba[4 * size_t(imageWidth) * y];
+        for (int c = 0; c < channels; ++c) {
+            const float *src = row(c, y);
+            for (unsigned int x = 0; x < imageWidth; ++x) {
+                dst[4 * x + c] = src[x];
+            }
+        }
+    }
+}
+
+void PlanarImage::copyAlpha(const PlanarImage &a_src)
+{
+    for (unsigned int y = 0; y < imageHeight; ++y) {
+        memcpy(row(3, y), a_src.row(3, y), imageWidth * sizeof(float));
+    }
+}
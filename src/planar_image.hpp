@@ -0,0 +1,48 @@
+#ifndef PLANAR_IMAGE_HPP
+#define PLANAR_IMAGE_HPP
+
+#include <cstddef>
+#include <vector>
+
+// Alignment of every row in bytes; rows are padded up to a multiple of it so
+// a row starts on a cache line and full-width vector loads stay in bounds.
+#define PLANAR_ALIGNMENT 64
+
+// Float image stored as four planes (R, G, B, A), the layout all CPU engines
+// work on. The interleaved RGBA floats of stbi_loadf are converted once after
+// loading and back once before saving. Padding columns are zero.
+class PlanarImage {
+    unsigned int imageWidth;
+    unsigned int imageHeight;
+    size_t rowStride;  // floats from one row to the next
+    std::vector<float> storage;
+    float *base;  // first aligned float in storage
+
+    PlanarImage(const PlanarImage &);
+    PlanarImage &operator=(const PlanarImage &);
+
+public:
+    static const int channels = 4;
+
+    PlanarImage(unsigned int width_, unsigned int height_);
+
+    unsigned int width() const { return imageWidth; }
+    unsigned int height() const { return imageHeight; }
+    size_t stride() const { return rowStride; }
+
+    float *row(int channel, int y)
+    {
+        return base + rowStride * (size_t(imageHeight) * channel + y);
+    }
+    const float *row(int channel, int y) const
+    {
+        return base + rowStride * (size_t(imageHeight) * channel + y);
+    }
+
+    void fromInterleaved(const float *rgba);
+    void toInterleaved(float *rgba) const;
+    // Copies the alpha plane of a_src, which must have the same size.
+    void copyAlpha(const PlanarImage &a_src);
+};
+
+#endif // PLANAR_IMAGE_HPP
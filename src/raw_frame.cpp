@@ -0,0 +1,108 @@
+#include "raw_frame.hpp"
+#include <fcntl.h>
+#include <omp.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdexcept>
+#include <vector>
+#include "pixel_format.hpp"
+#include "planar_image.hpp"
+
+bool isRawFrameFile(const std::string &a_name)
+{
+    const size_t len = a_name.size();
+    return len > 4 && a_name.compare(len - 4, 4, ".raw") == 0;
+}
+
+static uint32_t readLittleEndian(const unsigned char *a_bytes)
+{
+    return uint32_t(a_bytes[0]) | uint32_t(a_bytes[1]) << 8 |
+           uint32_t(a_bytes[2]) << 16 | uint32_t(a_bytes[3]) << 24;
+}
+
+RawFrame::RawFrame(const std::string &a_path)
+    : mapping(nullptr), mappingSize(0), frameWidth(0), frameHeight(0),
+      frameFormat(raw8)
+{
+    const int fd = open(a_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("failed to open " + a_path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || size_t(info.st_size) < RAW_FRAME_HEADER) {
+        close(fd);
+        throw std::runtime_error(a_path + ": not a raw frame");
+    }
+    mappingSize = size_t(info.st_size);
+    void *mapped = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("failed to map " + a_path);
+    }
+    mapping = (const unsigned char *)mapped;
+    madvise(mapped, mappingSize, MADV_SEQUENTIAL);
+
+    const uint32_t format = readLittleEndian(mapping + 12);
+    frameWidth = readLittleEndian(mapping + 4);
+    frameHeight = readLittleEndian(mapping + 8);
+    frameFormat = rawFormat(format);
+    if (memcmp(mapping, "VKRF", 4) != 0 || format > raw16 ||
+        frameWidth == 0 || frameHeight == 0 ||
+        (mappingSize - RAW_FRAME_HEADER) / stride() < frameHeight) {
+        munmap(mapped, mappingSize);
+        throw std::runtime_error(a_path + ": bad or truncated raw frame");
+    }
+}
+
+RawFrame::~RawFrame()
+{
+    munmap((void *)mapping, mappingSize);
+}
+
+void RawFrame::toLinear(unsigned int a_y, unsigned int a_x, size_t a_count,
+                        float *a_rgba) const
+{
+    if (frameFormat == raw8) {
+        rgba8ToLinear(row(a_y) + 4 * size_t(a_x), a_count, a_rgba);
+    }
+    else {
+        rgba16ToLinear((const uint16_t *)row(a_y) + 4 * size_t(a_x), a_count,
+                       a_rgba);
+    }
+}
+
+void RawFrame::toRgba8(unsigned int a_y, unsigned int a_x, size_t a_count,
+                       unsigned char *a_rgba) const
+{
+    if (frameFormat == raw8) {
+        memcpy(a_rgba, row(a_y) + 4 * size_t(a_x), 4 * a_count);
+        return;
+    }
+    const uint16_t *src = (const uint16_t *)row(a_y) + 4 * size_t(a_x);
+    for (size_t i = 0; i < 4 * a_count; ++i) {
+        a_rgba[i] = (unsigned char)(src[i] >> 8);
+    }
+}
+
+void RawFrame::toPlanar(PlanarImage &a_dst, int a_threads) const
+{
+    const int threads = a_threads > 0 ? a_threads : omp_get_max_threads();
+#pragma omp parallel num_threads(threads)
+    {
+        std::vector<float> rgba(4 * size_t(frameWidth));
+        long y;
+#pragma omp for schedule(static)
+        for (y = 0; y < long(frameHeight); ++y) {
+            toLinear(unsigned(y), 0, frameWidth, &rgba[0]);
+            for (int c = 0; c < PlanarImage::channels; ++c) {
+                float *dst = a_dst.row(c, int(y));
+                for (unsigned int x = 0; x < frameWidth; ++x) {
+                    dst[x] = rgba[4 * x + c];
+                }
+            }
+        }
+    }
+}
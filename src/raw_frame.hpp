@@ -0,0 +1,66 @@
+#ifndef RAW_FRAME_HPP
+#define RAW_FRAME_HPP
+
+#include <cstddef>
+#include <string>
+
+class PlanarImage;
+
+// Sample size of a raw frame: 8-bit or 16-bit unsigned normalized RGBA.
+enum rawFormat { raw8 = 0, raw16 = 1 };
+
+// Size of the header in front of the pixels of a .raw file.
+#define RAW_FRAME_HEADER 16
+
+// True when a_name ends in .raw: a frame dump of the capture pipeline, read
+// with RawFrame instead of stb_image.
+bool isRawFrameFile(const std::string &a_name);
+
+// A raw frame file mapped read-only. The header is four little-endian
+// uint32: the magic 'VKRF', width, height and the rawFormat; the pixels
+// follow in unpadded rows, 16-bit samples little-endian. Rows are read in
+// place, so no frame-sized buffer is allocated and the pages of converted
+// rows can be dropped by the kernel.
+class RawFrame {
+    const unsigned char *mapping;
+    size_t mappingSize;
+    unsigned int frameWidth;
+    unsigned int frameHeight;
+    rawFormat frameFormat;
+
+    RawFrame(const RawFrame &);
+    RawFrame &operator=(const RawFrame &);
+
+public:
+    // Throws std::runtime_error when a_path cannot be mapped, has no valid
+    // header or is shorter than the header says.
+    explicit RawFrame(const std::string &a_path);
+    ~RawFrame();
+
+    unsigned int width() const { return frameWidth; }
+    unsigned int height() const { return frameHeight; }
+    rawFormat format() const { return frameFormat; }
+    size_t stride() const
+    {
+        return (frameFormat == raw16 ? 8 : 4) * size_t(frameWidth);
+    }
+
+    const unsigned char *row(unsigned int a_y) const
+    {
+        return mapping + RAW_FRAME_HEADER + stride() * a_y;
+    }
+
+    // a_count pixels of row a_y from column a_x as linear RGBA floats, with
+    // the 2.2 gamma of stbi_loadf() on colour.
+    void toLinear(unsigned int a_y, unsigned int a_x, size_t a_count,
+                  float *a_rgba) const;
+    // The same pixels as 8-bit RGBA, 16-bit samples keeping their high
+    // byte; what --gpu-convert uploads.
+    void toRgba8(unsigned int a_y, unsigned int a_x, size_t a_count,
+                 unsigned char *a_rgba) const;
+    // The whole frame into a_dst, which must have its size, converting rows
+    // on a_threads OpenMP threads (0: all cores).
+    void toPlanar(PlanarImage &a_dst, int a_threads) const;
+};
+
+#endif // RAW_FRAME_HPP
@@ -0,0 +1,247 @@
+#include "simd_bilateral.hpp"
+#include <string.h>
+#include <algorithm>
+#include <cstddef>
+#include "cmath"
+
+// The vector kernels use GCC/Clang vector extensions compiled once per
+// instruction set through target attributes.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_BILATERAL_X86
+#endif
+
+namespace {
+
+// Arguments of one image row for the vector kernels.
+struct RowArgs {
+    const float *src[3];  // the row in the R, G and B planes of the source
+    float *dst[3];        // and of the result
+    std::ptrdiff_t stride;
+    const float *spatialTerms;
+    float rangeScale;
+    int radius;
+    int width;
+};
+
+// Fills the interior of a row, columns [radius, width - radius), in whole
+// vectors and returns the first column it left for the scalar path.
+typedef int (*RowKernel)(const RowArgs &);
+
+#ifdef SIMD_BILATERAL_X86
+
+typedef float v4sf __attribute__((vector_size(16)));
+typedef int v4si __attribute__((vector_size(16)));
+typedef float v8sf __attribute__((vector_size(32)));
+typedef int v8si __attribute__((vector_size(32)));
+typedef float v16sf __attribute__((vector_size(64)));
+typedef int v16si __attribute__((vector_size(64)));
+
+// Vectors are passed by reference: these helpers are instantiated outside
+// the target-specific functions, where wide vectors by value have no ABI.
+template <typename VF>
+static inline __attribute__((always_inline)) void loadu(VF &a_dst,
+                                                        const float *a_src)
+{
+    memcpy(&a_dst, a_src, sizeof(a_dst));
+}
+
+template <typename VF>
+static inline __attribute__((always_inline)) void storeu(float *a_dst,
+                                                         const VF &a_src)
+{
+    memcpy(a_dst, &a_src, sizeof(a_src));
+}
+
+// x = exp(x) for x <= 0 in the style of Cephes expf: x = n * ln2 + r with
+// |r| <= ln2 / 2, a degree 5 polynomial for e^r and 2^n built directly in the
+// exponent bits. Relative error is below 2e-7; inputs under -87 give about
+// 1e-38 instead of 0.
+template <typename VF, typename VI>
+static inline __attribute__((always_inline)) void vexp(VF &x)
+{
+    const float roundMagic = 12582912.0f;  // 1.5 * 2^23
+    x = x < -87.0f ? VF{} - 87.0f : x;
+
+    VF t = x * 1.44269504088896341f + roundMagic;
+    VF n = t - roundMagic;
+    VF r = x - n * 0.693359375f;
+    r = r - n * -2.12194440e-4f;
+
+    VF p = VF{} + 1.9875691500e-4f;
+    p = p * r + 1.3981999507e-3f;
+    p = p * r + 8.3334519073e-3f;
+    p = p * r + 4.1665795894e-2f;
+    p = p * r + 1.6666665459e-1f;
+    p = p * r + 5.0000001201e-1f;
+    p = p * r * r + r + 1.0f;
+
+    // the low mantissa bits of t hold n as an integer
+    VI bits = (VI)t - (VI)(VF{} + roundMagic);
+    VI scale = (bits + 127) << 23;
+    x = p * (VF)scale;
+}
+
+template <typename VF, typename VI>
+static inline __attribute__((always_inline)) int interiorRow(
+    const RowArgs &a)
+{
+    const int lanes = int(sizeof(VF) / sizeof(float));
+    int j = a.radius;
+    for (; j + lanes <= a.width - a.radius; j += lanes) {
+        VF center[3], sum[3], norm[3];
+        for (int c = 0; c < 3; ++c) {
+            loadu(center[c], a.src[c] + j);
+            sum[c] = VF{};
+            norm[c] = VF{};
+        }
+
+        const float *spatial = a.spatialTerms;
+        for (int dy = -a.radius; dy <= a.radius; ++dy) {
+            const std::ptrdiff_t offset = dy * a.stride + j;
+            for (int dx = -a.radius; dx <= a.radius; ++dx, ++spatial) {
+                for (int c = 0; c < 3; ++c) {
+                    VF neighbour;
+                    loadu(neighbour, a.src[c] + offset + dx);
+                    VF diff = neighbour - center[c];
+                    VF weight = -(diff * diff * a.rangeScale + *spatial);
+                    vexp<VF, VI>(weight);
+                    sum[c] += weight * neighbour;
+                    norm[c] += weight;
+                }
+            }
+        }
+
+        for (int c = 0; c < 3; ++c) {
+            VF out = sum[c] / norm[c];
+            storeu(a.dst[c] + j, out);
+        }
+    }
+    return j;
+}
+
+__attribute__((target("avx512f"))) static int rowAvx512(const RowArgs &a)
+{
+    return interiorRow<v16sf, v16si>(a);
+}
+
+__attribute__((target("avx2,fma"))) static int rowAvx2(const RowArgs &a)
+{
+    return interiorRow<v8sf, v8si>(a);
+}
+
+__attribute__((target("sse4.2"))) static int rowSse42(const RowArgs &a)
+{
+    return interiorRow<v4sf, v4si>(a);
+}
+
+#endif // SIMD_BILATERAL_X86
+
+static RowKernel selectKernel(const char **a_name)
+{
+#ifdef SIMD_BILATERAL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        *a_name = "avx512";
+        return rowAvx512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        *a_name = "avx2";
+        return rowAvx2;
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+        *a_name = "sse4.2";
+        return rowSse42;
+    }
+#endif
+    *a_name = "scalar";
+    return nullptr;
+}
+
+} // namespace
+
+const char *SimdBilateralFilter::isa()
+{
+    const char *name;
+    selectKernel(&name);
+    return name;
+}
+
+void SimdBilateralFilter::prepare()
+{
+    const int radius = params.radius;
+    const int side = 2 * radius + 1;
+    spatialTerms.resize(side * side);
+    for (int dy = -radius; dy <= radius; ++dy) {
+        for (int dx = -radius; dx <= radius; ++dx) {
+            spatialTerms[side * (dy + radius) + dx + radius] =
+                (dy * dy + dx * dx) * 1.f /
+                (2 * params.sigmaSpatial * params.sigmaSpatial);
+        }
+    }
+    rangeScale = 1.f / (2 * params.sigmaRange * params.sigmaRange);
+}
+
+// Border pixels and the tail of each row, and everything when no vector
+// kernel is available. Neighbours outside the image are skipped.
+void SimdBilateralFilter::scalarPixel(int row, int column)
+{
+    const int radius = params.radius;
+    const int side = 2 * radius + 1;
+    const int jMin = std::max(-radius, -row);
+    const int jMax = std::min(radius, int(height) - 1 - row);
+    const int kMin = std::max(-radius, -column);
+    const int kMax = std::min(radius, int(width) - 1 - column);
+
+    for (int c = 0; c < 3; ++c) {
+        const float center = oldImage.row(c, row)[column];
+        float sum = 0.0f;
+        float norm = 0.0f;
+        for (int j = jMin; j <= jMax; ++j) {
+            const float *src = oldImage.row(c, row + j) + column;
+            const float *spatial = &spatialTerms[side * (j + radius) + radius];
+            for (int k = kMin; k <= kMax; ++k) {
+                float diff = src[k] - center;
+                float weight = exp(-(diff * diff * rangeScale + spatial[k]));
+                sum += weight * src[k];
+                norm += weight;
+            }
+        }
+        newImage.row(c, row)[column] = sum / norm;
+    }
+}
+
+void SimdBilateralFilter::run()
+{
+    prepare();
+    const char *name;
+    const RowKernel kernel = selectKernel(&name);
+    const int radius = params.radius;
+
+    int i;
+#pragma omp parallel for num_threads(threads) schedule(static)
+    for (i = 0; i < int(height); ++i) {
+        int vectorBegin = 0;
+        int vectorEnd = 0;
+        if (kernel && i >= radius && i + radius < int(height)) {
+            RowArgs args = {{oldImage.row(0, i), oldImage.row(1, i),
+                             oldImage.row(2, i)},
+                            {newImage.row(0, i), newImage.row(1, i),
+                             newImage.row(2, i)},
+                            std::ptrdiff_t(oldImage.stride()),
+                            spatialTerms.data(),
+                            rangeScale,
+                            radius,
+                            int(width)};
+            vectorBegin = radius;
+            vectorEnd = kernel(args);
+        }
+        for (int j = 0; j < int(width); ++j) {
+            if (j == vectorBegin && vectorEnd > vectorBegin) {
+                j = vectorEnd - 1;
+                continue;
+            }
+            scalarPixel(i, j);
+        }
+    }
+    newImage.copyAlpha(oldImage);
+}
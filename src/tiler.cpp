@@ -0,0 +1,55 @@
+#include "tiler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+std::vector<Tile> splitIntoTiles(unsigned int a_width, unsigned int a_height,
+                                 unsigned int a_apron, size_t a_maxPixels)
+{
+    std::vector<Tile> tiles;
+    if (size_t(a_width) * a_height <= a_maxPixels) {
+        Tile tile;
+        tile.width = tile.coreWidth = a_width;
+        tile.height = tile.coreHeight = a_height;
+        tiles.push_back(tile);
+        return tiles;
+    }
+
+    // Square regions waste the least on aprons. Narrow images get strips of
+    // full rows instead, which need no apron at the sides.
+    const size_t side = size_t(std::sqrt(double(a_maxPixels)));
+    size_t coreWidth, coreHeight;
+    if (a_width <= side) {
+        coreWidth = a_width;
+        const size_t rows = a_maxPixels / a_width;
+        coreHeight = rows > 2 * size_t(a_apron) ? rows - 2 * a_apron : 0;
+    }
+    else {
+        coreWidth = side > 2 * size_t(a_apron) ? side - 2 * a_apron : 0;
+        coreHeight = coreWidth;
+    }
+    if (coreWidth == 0 || coreHeight == 0) {
+        throw std::runtime_error(
+            "memory budget too small for the filter window");
+    }
+
+    for (size_t y = 0; y < a_height; y += coreHeight) {
+        for (size_t x = 0; x < a_width; x += coreWidth) {
+            Tile tile;
+            tile.coreX = unsigned(x);
+            tile.coreY = unsigned(y);
+            tile.coreWidth = unsigned(std::min(coreWidth, a_width - x));
+            tile.coreHeight = unsigned(std::min(coreHeight, a_height - y));
+            tile.x = unsigned(x > a_apron ? x - a_apron : 0);
+            tile.y = unsigned(y > a_apron ? y - a_apron : 0);
+            tile.width = unsigned(std::min(size_t(a_width),
+                                           x + tile.coreWidth + a_apron) -
+                                  tile.x);
+            tile.height = unsigned(std::min(size_t(a_height),
+                                            y + tile.coreHeight + a_apron) -
+                                   tile.y);
+            tiles.push_back(tile);
+        }
+    }
+    return tiles;
+}
@@ -0,0 +1,25 @@
+#ifndef TILER_HPP
+#define TILER_HPP
+
+#include <cstddef>
+#include <vector>
+
+// Part of an image filtered on its own. The GPU reads the region (the core
+// plus an apron of neighbours, clipped to the image) and only the core of
+// the result is kept, so stitched tiles match the unsplit image.
+struct Tile {
+    unsigned int x = 0, y = 0;  // region, image coordinates
+    unsigned int width = 0, height = 0;
+    unsigned int coreX = 0, coreY = 0;  // core, image coordinates
+    unsigned int coreWidth = 0, coreHeight = 0;
+};
+
+// Covers a width x height image with tiles whose region is at most
+// a_maxPixels. a_apron is how far the filter reads around a pixel: the
+// radius for bilateral, radius + patch for NLM. A single tile without apron
+// is returned when the whole image fits. Throws std::runtime_error when not
+// even a one-pixel core fits with its apron.
+std::vector<Tile> splitIntoTiles(unsigned int a_width, unsigned int a_height,
+                                 unsigned int a_apron, size_t a_maxPixels);
+
+#endif // TILER_HPP
@@ -0,0 +1,195 @@
+#include "uncompressed.hpp"
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include "raw_frame.hpp"
+
+// Whole rows written with one call, at most.
+static const size_t blockBytes = size_t(4) << 20;
+
+uncompressedFormat uncompressedFormatOf(const std::string &a_name)
+{
+    static const char *extensions[] = {".bmp", ".ppm", ".pam", ".raw"};
+    static const uncompressedFormat formats[] = {bmpFile, ppmFile, pamFile,
+                                                 rawFile};
+    const size_t len = a_name.size();
+    for (int i = 0; i < 4; ++i) {
+        if (len > 4 && a_name.compare(len - 4, 4, extensions[i]) == 0) {
+            return formats[i];
+        }
+    }
+    return notUncompressed;
+}
+
+static void putLittleEndian(unsigned char *a_dst, uint32_t a_value)
+{
+    a_dst[0] = (unsigned char)a_value;
+    a_dst[1] = (unsigned char)(a_value >> 8);
+    a_dst[2] = (unsigned char)(a_value >> 16);
+    a_dst[3] = (unsigned char)(a_value >> 24);
+}
+
+UncompressedWriter::UncompressedWriter(const std::string &a_path,
+                                       unsigned int a_width,
+                                       unsigned int a_height)
+    : path(a_path), fd(-1), fileFormat(uncompressedFormatOf(a_path)),
+      imageWidth(a_width), imageHeight(a_height), dataOffset(0),
+      fileStride(0), failed(false)
+{
+    fileStride = pixelSize() * a_width;
+    std::string header;
+    if (fileFormat == bmpFile) {
+        fileStride = (fileStride + 3) & ~size_t(3);
+        dataOffset = 54;
+        const uint64_t fileSize = dataOffset + uint64_t(fileStride) * a_height;
+        if (fileSize > UINT32_MAX) {
+            throw std::runtime_error(a_path + ": too large for BMP");
+        }
+        unsigned char bmp[54] = {'B', 'M'};
+        putLittleEndian(bmp + 2, uint32_t(fileSize));
+        putLittleEndian(bmp + 10, 54);  // pixel data offset
+        putLittleEndian(bmp + 14, 40);  // BITMAPINFOHEADER
+        putLittleEndian(bmp + 18, a_width);
+        putLittleEndian(bmp + 22, a_height);  // positive: bottom-up
+        bmp[26] = 1;   // planes
+        bmp[28] = 24;  // bits per pixel, BI_RGB
+        putLittleEndian(bmp + 34, uint32_t(fileStride * a_height));
+        putLittleEndian(bmp + 38, 2835);  // 72 dpi
+        putLittleEndian(bmp + 42, 2835);
+        header.assign((const char *)bmp, sizeof(bmp));
+    }
+    else if (fileFormat == ppmFile || fileFormat == pamFile) {
+        std::ostringstream text;
+        if (fileFormat == ppmFile) {
+            text << "P6\n" << a_width << " " << a_height << "\n255\n";
+        }
+        else {
+            text << "P7\nWIDTH " << a_width << "\nHEIGHT " << a_height
+                 << "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+        }
+        header = text.str();
+        dataOffset = header.size();
+    }
+    else if (fileFormat == rawFile) {
+        unsigned char raw[RAW_FRAME_HEADER] = {'V', 'K', 'R', 'F'};
+        putLittleEndian(raw + 4, a_width);
+        putLittleEndian(raw + 8, a_height);
+        putLittleEndian(raw + 12, raw8);
+        header.assign((const char *)raw, sizeof(raw));
+        dataOffset = header.size();
+    }
+    else {
+        throw std::runtime_error(a_path + ": not an uncompressed format");
+    }
+
+    fd = open(a_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("failed to create " + a_path);
+    }
+    // at its final size up front, so BMP padding and rows not written yet
+    // read as zeros
+    if (ftruncate(fd, off_t(dataOffset + fileStride * a_height)) != 0) {
+        failed = true;
+    }
+    writeAt((const unsigned char *)header.data(), header.size(), 0);
+}
+
+UncompressedWriter::~UncompressedWriter()
+{
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+size_t UncompressedWriter::pixelSize() const
+{
+    return fileFormat == bmpFile || fileFormat == ppmFile ? 3 : 4;
+}
+
+size_t UncompressedWriter::rowOffset(unsigned int a_y) const
+{
+    const unsigned int fileRow =
+        fileFormat == bmpFile ? imageHeight - 1 - a_y : a_y;
+    return dataOffset + fileStride * fileRow;
+}
+
+void UncompressedWriter::convertRow(const unsigned char *a_rgba,
+                                    unsigned int a_count,
+                                    unsigned char *a_dst) const
+{
+    if (fileFormat == pamFile || fileFormat == rawFile) {
+        memcpy(a_dst, a_rgba, 4 * size_t(a_count));
+        return;
+    }
+    const bool bgr = fileFormat == bmpFile;
+    for (unsigned int i = 0; i < a_count; ++i) {
+        a_dst[3 * i + 0] = a_rgba[4 * i + (bgr ? 2 : 0)];
+        a_dst[3 * i + 1] = a_rgba[4 * i + 1];
+        a_dst[3 * i + 2] = a_rgba[4 * i + (bgr ? 0 : 2)];
+    }
+}
+
+void UncompressedWriter::writeAt(const unsigned char *a_data, size_t a_size,
+                                 size_t a_offset)
+{
+    while (a_size > 0 && !failed) {
+        const ssize_t written = pwrite(fd, a_data, a_size, off_t(a_offset));
+        if (written <= 0) {
+            failed = true;
+            return;
+        }
+        a_data += written;
+        a_size -= size_t(written);
+        a_offset += size_t(written);
+    }
+}
+
+void UncompressedWriter::writeRegion(unsigned int a_x, unsigned int a_y,
+                                     unsigned int a_width,
+                                     unsigned int a_height,
+                                     const unsigned char *a_rgba,
+                                     size_t a_stride)
+{
+    if (a_x != 0 || a_width != imageWidth) {
+        block.resize(pixelSize() * a_width);
+        for (unsigned int i = 0; i < a_height; ++i) {
+            convertRow(a_rgba + a_stride * i, a_width, &block[0]);
+            writeAt(&block[0], block.size(),
+                    rowOffset(a_y + i) + pixelSize() * a_x);
+        }
+        return;
+    }
+
+    // whole rows are contiguous in the file, in reverse for BMP; padding
+    // is part of fileStride and written as zeros
+    const unsigned int blockRows = unsigned(
+        std::max<size_t>(1, std::min<size_t>(a_height,
+                                             blockBytes / fileStride)));
+    block.assign(fileStride * blockRows, 0);
+    for (unsigned int first = 0; first < a_height; first += blockRows) {
+        const unsigned int rows = std::min(blockRows, a_height - first);
+        for (unsigned int i = 0; i < rows; ++i) {
+            const unsigned int blockRow =
+                fileFormat == bmpFile ? rows - 1 - i : i;
+            convertRow(a_rgba + a_stride * (first + i), a_width,
+                       &block[fileStride * blockRow]);
+        }
+        const unsigned int lowest = fileFormat == bmpFile
+                                        ? a_y + first + rows - 1
+                                        : a_y + first;
+        writeAt(&block[0], fileStride * rows, rowOffset(lowest));
+    }
+}
+
+void UncompressedWriter::close()
+{
+    const int result = ::close(fd);
+    fd = -1;
+    if (failed || result != 0) {
+        throw std::runtime_error("failed to write " + path);
+    }
+}
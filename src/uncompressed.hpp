@@ -0,0 +1,59 @@
+#ifndef UNCOMPRESSED_HPP
+#define UNCOMPRESSED_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Output formats written without compression, chosen by file extension:
+// 24-bit BMP (bottom-up, rows padded to 4 bytes), binary PPM (P6, RGB),
+// PAM (P7, RGB_ALPHA) and raw frames in the layout RawFrame reads.
+enum uncompressedFormat { notUncompressed, bmpFile, ppmFile, pamFile,
+                          rawFile };
+
+uncompressedFormat uncompressedFormatOf(const std::string &a_name);
+
+// Writes an image region by region as results come in, converting 8-bit
+// RGBA straight into the file layout. Every pixel has a fixed place in
+// these formats, so regions may arrive in any order and no frame-sized
+// buffer is needed. Rows that span the whole width go out in blocks with
+// one write each.
+class UncompressedWriter {
+    std::string path;
+    int fd;
+    uncompressedFormat fileFormat;
+    unsigned int imageWidth;
+    unsigned int imageHeight;
+    size_t dataOffset;  // header bytes
+    size_t fileStride;  // bytes per row in the file, with padding
+    bool failed;
+    std::vector<unsigned char> block;
+
+    UncompressedWriter(const UncompressedWriter &);
+    UncompressedWriter &operator=(const UncompressedWriter &);
+
+    size_t pixelSize() const;
+    size_t rowOffset(unsigned int a_y) const;
+    void convertRow(const unsigned char *a_rgba, unsigned int a_count,
+                    unsigned char *a_dst) const;
+    void writeAt(const unsigned char *a_data, size_t a_size, size_t a_offset);
+
+public:
+    // Creates a_path at its final size with the header of its format.
+    // Throws std::runtime_error when it cannot be created or the format
+    // cannot hold the size (BMP over 4 GiB).
+    UncompressedWriter(const std::string &a_path, unsigned int a_width,
+                       unsigned int a_height);
+    ~UncompressedWriter();
+
+    // a_width x a_height RGBA8 pixels, rows a_stride bytes apart, to their
+    // place at a_x, a_y.
+    void writeRegion(unsigned int a_x, unsigned int a_y, unsigned int a_width,
+                     unsigned int a_height, const unsigned char *a_rgba,
+                     size_t a_stride);
+
+    // Closes the file. Throws std::runtime_error when any write failed.
+    void close();
+};
+
+#endif // UNCOMPRESSED_HPP
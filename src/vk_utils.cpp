@@ -6,6 +6,8 @@
 
 #include <string.h>
 #include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
 #include <iostream>
 
 #include <cmath>
@@ -25,7 +27,8 @@ static const char* g_debugReportExtName  = VK_EXT_DEBUG_REPORT_EXTENSION_NAME;
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
-VkInstance vk_utils::CreateInstance(bool a_enableValidationLayers, std::vector<const char *>& a_enabledLayers, std::vector<const char *> a_extentions)
+VkInstance vk_utils::CreateInstance(bool a_enableValidationLayers, std::vector<const char *>& a_enabledLayers, std::vector<const char *> a_extentions,
+                                    uint32_t* a_pApiVersion)
 {
   std::vector<const char *> enabledExtensions = a_extentions;
   if (a_enableValidationLayers)
@@ -39,7 +42,6 @@ VkInstance vk_utils::CreateInstance(bool a_enableValidationLayers, std::vector<c
     bool foundLayer = false;
     for (VkLayerProperties prop : layerProperties) 
     {
-      std::cout << prop.layerName <<std::endl;
       if (strcmp("VK_LAYER_LUNARG_standard_validation", prop.layerName) == 0 || 
           strcmp("VK_LAYER_KHRONOS_validation", prop.layerName) == 0) 
       {
@@ -92,6 +94,15 @@ VkInstance vk_utils::CreateInstance(bool a_enableValidationLayers, std::vector<c
   applicationInfo.engineVersion      = 0;
   applicationInfo.apiVersion         = VK_API_VERSION_1_0;
 
+  // Vulkan 1.1 when the loader has it, for the core external memory and
+  // vkGetPhysicalDeviceProperties2 that VK_EXT_external_memory_host needs.
+  //
+  PFN_vkEnumerateInstanceVersion enumerateInstanceVersion =
+    (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(NULL, "vkEnumerateInstanceVersion");
+  uint32_t loaderVersion = VK_API_VERSION_1_0;
+  if (enumerateInstanceVersion != nullptr && enumerateInstanceVersion(&loaderVersion) == VK_SUCCESS && loaderVersion >= VK_API_VERSION_1_1)
+    applicationInfo.apiVersion = VK_API_VERSION_1_1;
+
   VkInstanceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
   createInfo.flags = 0;
@@ -110,6 +121,8 @@ VkInstance vk_utils::CreateInstance(bool a_enableValidationLayers, std::vector<c
   VkInstance instance;
   VK_CHECK_RESULT(vkCreateInstance(&createInfo, NULL, &instance));
 
+  if (a_pApiVersion != nullptr)
+    (*a_pApiVersion) = applicationInfo.apiVersion;
   return instance;
 }
 
@@ -256,16 +269,48 @@ uint32_t vk_utils::GetQueueFamilyIndex(VkPhysicalDevice a_physicalDevice, VkQueu
 }
 
 
+// A family that can copy but neither draw nor dispatch is usually backed by
+// a DMA engine that runs independently of the compute units.
+uint32_t vk_utils::GetTransferQueueFamilyIndex(VkPhysicalDevice a_physicalDevice)
+{
+  uint32_t queueFamilyCount;
+  vkGetPhysicalDeviceQueueFamilyProperties(a_physicalDevice, &queueFamilyCount, NULL);
+
+  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(a_physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+  for (uint32_t i = 0; i < queueFamilies.size(); ++i)
+  {
+    VkQueueFlags flags = queueFamilies[i].queueFlags;
+    if (queueFamilies[i].queueCount > 0 && (flags & VK_QUEUE_TRANSFER_BIT) &&
+        !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+      return i;
+  }
+
+  return uint32_t(-1);
+}
+
+
 VkDevice vk_utils::CreateLogicalDevice(uint32_t queueFamilyIndex, VkPhysicalDevice physicalDevice, const std::vector<const char *>& a_enabledLayers, std::vector<const char *> a_extentions)
 {
-  // When creating the device, we also specify what queues it has.
+  return CreateLogicalDevice(std::vector<uint32_t>(1, queueFamilyIndex), physicalDevice, a_enabledLayers, a_extentions);
+}
+
+VkDevice vk_utils::CreateLogicalDevice(const std::vector<uint32_t>& a_queueFamilyIndices, VkPhysicalDevice physicalDevice, const std::vector<const char *>& a_enabledLayers, std::vector<const char *> a_extentions)
+{
+  // When creating the device, we also specify what queues it has: one queue in each of the given families.
   //
-  VkDeviceQueueCreateInfo queueCreateInfo = {};
-  queueCreateInfo.sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-  queueCreateInfo.queueFamilyIndex = queueFamilyIndex;
-  queueCreateInfo.queueCount       = 1;    // create one queue in this family. We don't need more.
-  float queuePriorities            = 1.0;  // we only have one queue, so this is not that imporant.
-  queueCreateInfo.pQueuePriorities = &queuePriorities;
+  float queuePriorities = 1.0;
+  std::vector<VkDeviceQueueCreateInfo> queueCreateInfos(a_queueFamilyIndices.size());
+  for (size_t i = 0; i < a_queueFamilyIndices.size(); ++i)
+  {
+    VkDeviceQueueCreateInfo queueCreateInfo = {};
+    queueCreateInfo.sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueCreateInfo.queueFamilyIndex = a_queueFamilyIndices[i];
+    queueCreateInfo.queueCount       = 1;
+    queueCreateInfo.pQueuePriorities = &queuePriorities;
+    queueCreateInfos[i] = queueCreateInfo;
+  }
 
   // Now we create the logical device. The logical device allows us to interact with the physical device.
   //
@@ -278,8 +323,8 @@ VkDevice vk_utils::CreateLogicalDevice(uint32_t queueFamilyIndex, VkPhysicalDevi
   deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
   deviceCreateInfo.enabledLayerCount    = uint32_t(a_enabledLayers.size());  // need to specify validation layers here as well.
   deviceCreateInfo.ppEnabledLayerNames  = a_enabledLayers.data();
-  deviceCreateInfo.pQueueCreateInfos    = &queueCreateInfo;        // when creating the logical device, we also specify what queues it has.
-  deviceCreateInfo.queueCreateInfoCount = 1;
+  deviceCreateInfo.pQueueCreateInfos    = queueCreateInfos.data(); // when creating the logical device, we also specify what queues it has.
+  deviceCreateInfo.queueCreateInfoCount = uint32_t(queueCreateInfos.size());
   deviceCreateInfo.pEnabledFeatures     = &deviceFeatures;
   deviceCreateInfo.enabledExtensionCount   = static_cast<uint32_t>(a_extentions.size());
   deviceCreateInfo.ppEnabledExtensionNames = a_extentions.data();
@@ -524,3 +569,197 @@ void vk_utils::CreateScreenFrameBuffers(VkDevice a_device, VkRenderPass a_render
 }
 
 
+
+std::string vk_utils::PipelineCachePath(VkPhysicalDevice a_physDevice, const std::string& a_dir)
+{
+  VkPhysicalDeviceProperties props;
+  vkGetPhysicalDeviceProperties(a_physDevice, &props);
+
+  std::stringstream name;
+  name << a_dir << "/";
+  for (uint32_t i = 0; i < VK_UUID_SIZE; i++)
+  {
+    char hex[3];
+    snprintf(hex, sizeof(hex), "%02x", props.pipelineCacheUUID[i]);
+    name << hex;
+  }
+  name << "-" << props.driverVersion << ".bin";
+  return name.str();
+}
+
+// The file name already carries the cache UUID, but a copied or truncated
+// file must not reach the driver: the data is only used when its header
+// (VkPipelineCacheHeaderVersionOne) names this very device.
+//
+static bool CacheHeaderMatches(const std::vector<char>& a_data, const VkPhysicalDeviceProperties& a_props)
+{
+  const size_t headerSize = 16 + VK_UUID_SIZE;
+  if (a_data.size() < headerSize)
+    return false;
+
+  uint32_t fields[4]; // header length, header version, vendor id, device id
+  memcpy(fields, a_data.data(), sizeof(fields));
+  return fields[0] >= headerSize && fields[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         fields[2] == a_props.vendorID && fields[3] == a_props.deviceID &&
+         memcmp(a_data.data() + 16, a_props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+VkPipelineCache vk_utils::CreatePipelineCache(VkDevice a_device, VkPhysicalDevice a_physDevice, const std::string& a_path, size_t* a_pLoadedSize)
+{
+  std::vector<char> data;
+  FILE* fp = fopen(a_path.c_str(), "rb");
+  if (fp != NULL)
+  {
+    fseek(fp, 0, SEEK_END);
+    long filesize = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (filesize > 0)
+    {
+      data.resize(size_t(filesize));
+      if (fread(data.data(), 1, data.size(), fp) != data.size())
+        data.clear();
+    }
+    fclose(fp);
+  }
+
+  VkPhysicalDeviceProperties props;
+  vkGetPhysicalDeviceProperties(a_physDevice, &props);
+  if (!CacheHeaderMatches(data, props))
+    data.clear();
+
+  VkPipelineCacheCreateInfo createInfo = {};
+  createInfo.sType           = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  createInfo.initialDataSize = data.size();
+  createInfo.pInitialData    = data.empty() ? nullptr : data.data();
+
+  VkPipelineCache cache = VK_NULL_HANDLE;
+  VK_CHECK_RESULT(vkCreatePipelineCache(a_device, &createInfo, NULL, &cache));
+  if (a_pLoadedSize != nullptr)
+    (*a_pLoadedSize) = data.size();
+  return cache;
+}
+
+// Written to a temporary file and renamed over a_path, so concurrent runs
+// never read a half written cache.
+//
+bool vk_utils::SavePipelineCache(VkDevice a_device, VkPipelineCache a_cache, const std::string& a_path)
+{
+  size_t size = 0;
+  VK_CHECK_RESULT(vkGetPipelineCacheData(a_device, a_cache, &size, nullptr));
+  std::vector<char> data(size);
+  VK_CHECK_RESULT(vkGetPipelineCacheData(a_device, a_cache, &size, data.data()));
+
+  std::stringstream tmpName;
+  tmpName << a_path << ".tmp" << getpid();
+  const std::string tmpPath = tmpName.str();
+  FILE* fp = fopen(tmpPath.c_str(), "wb");
+  if (fp == NULL)
+    return false;
+
+  const bool written = fwrite(data.data(), 1, size, fp) == size;
+  if (fclose(fp) != 0 || !written || rename(tmpPath.c_str(), a_path.c_str()) != 0)
+  {
+    remove(tmpPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+
+bool vk_utils::IsDeviceExtensionSupported(VkPhysicalDevice a_physDevice, const char* a_name)
+{
+  uint32_t count = 0;
+  VK_CHECK_RESULT(vkEnumerateDeviceExtensionProperties(a_physDevice, NULL, &count, NULL));
+  std::vector<VkExtensionProperties> extensions(count);
+  VK_CHECK_RESULT(vkEnumerateDeviceExtensionProperties(a_physDevice, NULL, &count, extensions.data()));
+  for (uint32_t i = 0; i < count; i++)
+  {
+    if (strcmp(extensions[i].extensionName, a_name) == 0)
+      return true;
+  }
+  return false;
+}
+
+VkDeviceSize vk_utils::HostImportAlignment(VkPhysicalDevice a_physDevice, uint32_t a_instanceVersion)
+{
+  // vkGetPhysicalDeviceProperties2 and the core external memory are only
+  // there when both the instance and the device are 1.1.
+  //
+  VkPhysicalDeviceProperties props;
+  vkGetPhysicalDeviceProperties(a_physDevice, &props);
+  if (a_instanceVersion < VK_API_VERSION_1_1 || props.apiVersion < VK_API_VERSION_1_1 ||
+      !IsDeviceExtensionSupported(a_physDevice, VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME))
+    return 0;
+
+  VkPhysicalDeviceExternalMemoryHostPropertiesEXT hostProps = {};
+  hostProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT;
+  VkPhysicalDeviceProperties2 props2 = {};
+  props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  props2.pNext = &hostProps;
+  vkGetPhysicalDeviceProperties2(a_physDevice, &props2);
+  return hostProps.minImportedHostPointerAlignment;
+}
+
+// Host-coherent memory only: imported pages are never mapped through
+// vkMapMemory, so there is nothing to flush or invalidate them with.
+//
+bool vk_utils::ImportHostMemory(VkDevice a_device, VkPhysicalDevice a_physDevice, void* a_pointer, VkDeviceSize a_size,
+                                VkBufferUsageFlags a_usage, VkBuffer* a_pBuffer, VkDeviceMemory* a_pMemory)
+{
+  const VkExternalMemoryHandleTypeFlagBits handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+  PFN_vkGetMemoryHostPointerPropertiesEXT getHostPointerProperties =
+    (PFN_vkGetMemoryHostPointerPropertiesEXT)vkGetDeviceProcAddr(a_device, "vkGetMemoryHostPointerPropertiesEXT");
+  if (getHostPointerProperties == nullptr)
+    return false;
+
+  VkMemoryHostPointerPropertiesEXT pointerProps = {};
+  pointerProps.sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT;
+  if (getHostPointerProperties(a_device, handleType, a_pointer, &pointerProps) != VK_SUCCESS)
+    return false;
+
+  VkExternalMemoryBufferCreateInfo externalInfo = {};
+  externalInfo.sType       = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO;
+  externalInfo.handleTypes = handleType;
+
+  VkBufferCreateInfo bufferCreateInfo = {};
+  bufferCreateInfo.sType       = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferCreateInfo.pNext       = &externalInfo;
+  bufferCreateInfo.size        = a_size;
+  bufferCreateInfo.usage       = a_usage;
+  bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  VkBuffer buffer = VK_NULL_HANDLE;
+  VK_CHECK_RESULT(vkCreateBuffer(a_device, &bufferCreateInfo, NULL, &buffer));
+
+  VkMemoryRequirements memoryRequirements;
+  vkGetBufferMemoryRequirements(a_device, buffer, &memoryRequirements);
+  const uint32_t memoryType = FindMemoryType(memoryRequirements.memoryTypeBits & pointerProps.memoryTypeBits,
+                                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                             a_physDevice);
+  if (memoryType == uint32_t(-1) || memoryRequirements.size > a_size)
+  {
+    vkDestroyBuffer(a_device, buffer, NULL);
+    return false;
+  }
+
+  VkImportMemoryHostPointerInfoEXT importInfo = {};
+  importInfo.sType        = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT;
+  importInfo.handleType   = handleType;
+  importInfo.pHostPointer = a_pointer;
+
+  VkMemoryAllocateInfo allocateInfo = {};
+  allocateInfo.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocateInfo.pNext           = &importInfo;
+  allocateInfo.allocationSize  = a_size;
+  allocateInfo.memoryTypeIndex = memoryType;
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  if (vkAllocateMemory(a_device, &allocateInfo, NULL, &memory) != VK_SUCCESS)
+  {
+    vkDestroyBuffer(a_device, buffer, NULL);
+    return false;
+  }
+  VK_CHECK_RESULT(vkBindBufferMemory(a_device, buffer, memory, 0));
+
+  (*a_pBuffer) = buffer;
+  (*a_pMemory) = memory;
+  return true;
+}
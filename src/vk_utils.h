@@ -4,6 +4,7 @@
 
 #include <vulkan/vulkan.h>
 #include <vector>
+#include <string>
 
 #include <stdexcept>
 #include <sstream>
@@ -29,15 +30,20 @@ namespace vk_utils
   }
 
 
-  VkInstance CreateInstance(bool a_enableValidationLayers, std::vector<const char *>& a_enabledLayers, std::vector<const char *> a_extentions = std::vector<const char *>());
+  VkInstance CreateInstance(bool a_enableValidationLayers, std::vector<const char *>& a_enabledLayers, std::vector<const char *> a_extentions = std::vector<const char *>(),
+                            uint32_t* a_pApiVersion = nullptr); // a_pApiVersion receives the version the instance was created for
   void       InitDebugReportCallback(VkInstance a_instance, DebugReportCallbackFuncType a_callback, VkDebugReportCallbackEXT* a_debugReportCallback);
   VkPhysicalDevice FindPhysicalDevice(VkInstance a_instance, bool a_printInfo, int a_preferredDeviceId);
 
   uint32_t GetQueueFamilyIndex(VkPhysicalDevice a_physicalDevice, VkQueueFlagBits a_bits);
   uint32_t GetComputeQueueFamilyIndex(VkPhysicalDevice a_physicalDevice);
+  uint32_t GetTransferQueueFamilyIndex(VkPhysicalDevice a_physicalDevice); // uint32_t(-1) if none
   VkDevice CreateLogicalDevice(uint32_t queueFamilyIndex, VkPhysicalDevice physicalDevice, 
                                const std::vector<const char *>& a_enabledLayers = std::vector<const char *>(), 
                                std::vector<const char *> a_extentions = std::vector<const char *>());
+  VkDevice CreateLogicalDevice(const std::vector<uint32_t>& a_queueFamilyIndices, VkPhysicalDevice physicalDevice,
+                               const std::vector<const char *>& a_enabledLayers = std::vector<const char *>(),
+                               std::vector<const char *> a_extentions = std::vector<const char *>());
   uint32_t FindMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags properties, VkPhysicalDevice physicalDevice);
 
   //// FrameBuffer and SwapChain issues
@@ -61,6 +67,19 @@ namespace vk_utils
 
   std::vector<uint32_t> ReadFile(const char* filename);
   VkShaderModule CreateShaderModule(VkDevice a_device, const std::vector<uint32_t>& code);
+
+  //// Pipeline cache on disk
+  //
+  std::string     PipelineCachePath(VkPhysicalDevice a_physDevice, const std::string& a_dir); // a_dir/<device UUID>-<driver version>.bin
+  VkPipelineCache CreatePipelineCache(VkDevice a_device, VkPhysicalDevice a_physDevice, const std::string& a_path, size_t* a_pLoadedSize); // seeded from a_path when it was written by this device
+  bool            SavePipelineCache(VkDevice a_device, VkPipelineCache a_cache, const std::string& a_path);                           // false if a_path could not be written
+
+  //// Caller memory imported with VK_EXT_external_memory_host
+  //
+  bool         IsDeviceExtensionSupported(VkPhysicalDevice a_physDevice, const char* a_name);
+  VkDeviceSize HostImportAlignment(VkPhysicalDevice a_physDevice, uint32_t a_instanceVersion); // minImportedHostPointerAlignment, 0 when the device can't import
+  bool         ImportHostMemory(VkDevice a_device, VkPhysicalDevice a_physDevice, void* a_pointer, VkDeviceSize a_size,
+                                VkBufferUsageFlags a_usage, VkBuffer* a_pBuffer, VkDeviceMemory* a_pMemory); // a_pointer and a_size aligned; false to fall back to a copy
 };
 
 #undef  RUN_TIME_ERROR
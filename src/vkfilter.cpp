@@ -0,0 +1,2928 @@
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <assert.h>
+#include <stb_image.h>
+#include <stb_image_write.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vulkan/vulkan.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <deque>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "Bitmap.h"
+#include "batch.hpp"
+#include "benchmark.hpp"
+#include "bilateral.hpp"
+#include "codec.hpp"
+#include "fast_bilateral.hpp"
+#include "filter_params.hpp"
+#include "integral_nlm.hpp"
+#include "nlm.hpp"
+#include "pixel_format.hpp"
+#include "planar_image.hpp"
+#include "raw_frame.hpp"
+#include "simd_bilateral.hpp"
+#include "tiler.hpp"
+#include "uncompressed.hpp"
+#include "vkfilter.hpp"
+
+// Fixed frame used by the thread scaling benchmark (--mode bench).
+const unsigned int BENCH_WIDTH = 1024;
+const unsigned int BENCH_HEIGHT = 768;
+
+// Validation layers are opt-in (cmake -DVKFILTER_VALIDATION=ON); their
+// reports go to stderr.
+#ifdef VKFILTER_VALIDATION
+constexpr bool enableValidationLayers = true;
+#else
+constexpr bool enableValidationLayers = false;
+#endif
+
+#include "vk_utils.h"
+
+namespace vkfilter {
+
+class ComputeApplication {
+private:
+    struct Pixel {
+        float r, g, b, a;
+    };
+
+    // Mirrors params_t in the .comp files. dy/dx is the search offset of
+    // the integral NLM passes; the other shaders only declare width/height.
+    struct PushConstants {
+        int width;
+        int height;
+        int dy;
+        int dx;
+    };
+
+    // Values of the constant_id declarations in the .comp files; ids 0 and 1
+    // (local_size_x_id/local_size_y_id) and 6 (TILE_SIZE of nlm_tiled.comp)
+    // all read workgroupSize. For NLM
+    // sigma1/sigma2 carry SYGMA and STEP, for bilateral the spatial and
+    // range sigmas. format (id 7) is the pixelFormat of pixel_format.glsl.
+    struct SpecConstants {
+        int workgroupSize;
+        int radius;
+        int patch;
+        float sigma1;
+        float sigma2;
+        int format;
+        VkBool32 linearize;  // unpack_rgba8 only
+
+        bool operator<(const SpecConstants &a_other) const
+        {
+            return std::tie(workgroupSize, radius, patch, sigma1, sigma2,
+                            format, linearize) <
+                   std::tie(a_other.workgroupSize, a_other.radius,
+                            a_other.patch, a_other.sigma1, a_other.sigma2,
+                            a_other.format, a_other.linearize);
+        }
+    };
+
+    // Copies recorded around the dispatch when the working buffers are
+    // device local. Both pairs are VK_NULL_HANDLE on UMA devices. When the
+    // copies run on a dedicated transfer queue, input and output change
+    // queue family between the copy and the dispatch; otherwise both
+    // families are VK_QUEUE_FAMILY_IGNORED.
+    struct StagingCopies {
+        VkBuffer upload, input;     // host -> device before the dispatch
+        VkBuffer output, readback;  // device -> host after it
+        VkDeviceSize size;
+        uint32_t computeFamily, transferFamily;
+    };
+
+    struct DeviceBuffer {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void *mapped = nullptr;  // host-visible memory stays mapped
+    };
+
+    // A decoded image on its way through the slots, one tile per slot.
+    // Tiles are stored into result as they retire; the last one writes it.
+    struct Frame {
+        // RGBA32F, or RGBA8 in packed with --gpu-convert or from the
+        // caller of filter(); decoded ones are freed once every tile is
+        // uploaded
+        float *pixels = nullptr;
+        const unsigned char *packed = nullptr;
+        size_t packedStride = 0;  // bytes between rows of packed
+        // .raw input, mapped and read in place; unmapped with the above
+        std::shared_ptr<RawFrame> raw;
+        unsigned int width = 0, height = 0;
+        std::string inputName;
+        std::string outputName;  // empty: result is caller memory
+        std::vector<Tile> tiles;
+        size_t tilesLeft = 0;  // not retired yet
+        // RGBA8 rows resultStride bytes apart, in resultStorage for files
+        unsigned char *result = nullptr;
+        size_t resultStride = 0;
+        std::vector<unsigned char> resultStorage;
+        // uncompressed output: tiles go from the readback memory straight
+        // into the file and there is no result
+        std::shared_ptr<UncompressedWriter> writer;
+        FrameTimes times;  // summed over the tiles
+        std::string error;  // decodeFrame() failed
+    };
+
+    // Buffers, descriptor set, command buffer and fence the buffer path
+    // filters a tile with; params.inFlight of them form a ring. The
+    // buffers are sized for the largest tile the slot has seen and only
+    // recreated when a bigger one arrives.
+    struct FrameSlot {
+        DeviceBuffer upload;    // host visible, binding 0 on UMA devices
+        DeviceBuffer input;     // device-local copy of upload, binding 0
+        DeviceBuffer output;    // binding 1
+        DeviceBuffer readback;  // host-visible copy of output
+        DeviceBuffer rowBox, prefix, accum;  // integral NLM, bindings 2..4
+        // --gpu-convert: upload and input hold RGBA8 at binding 5, source
+        // is the unpacked image at binding 0 and packed the RGBA8 result at
+        // binding 6, read back instead of output
+        DeviceBuffer source, packed;
+        // filter(): the caller's rows imported in place of upload and of
+        // readback (or of the bound result on UMA) for the current tile
+        DeviceBuffer hostSource, hostResult;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        // dedicated transfer queue only: the copies in command buffers of
+        // their own, chained to the dispatch by the two semaphores
+        VkCommandBuffer uploadCommands = VK_NULL_HANDLE;
+        VkCommandBuffer readbackCommands = VK_NULL_HANDLE;
+        VkSemaphore uploaded = VK_NULL_HANDLE;
+        VkSemaphore filtered = VK_NULL_HANDLE;
+        uint32_t index = 0;  // timestamp queries from timestampsPerSlot * index
+        size_t pixelCapacity = 0;
+        size_t prefixCapacity = 0;
+
+        // the tile submitted last, until retireFrame() stores it
+        bool pending = false;
+        unsigned int width = 0, height = 0;  // of the tile's region
+        std::shared_ptr<Frame> frame;
+        Tile tile;
+    };
+
+    FilterParams params;
+    // NLM kernel asked for at open(); checkNlmKernel() may fall back from
+    // it for one filter() call without giving it up for the next.
+    nlmKernel openKernel = direct;
+    std::vector<FrameSlot> slots;
+    size_t nextSlot = 0;  // ring position of the next tile
+    // Decode and encode workers of run(), see processFrames()
+    std::unique_ptr<CodecPool> codecs;
+    // Results being written by the workers, oldest first
+    std::deque<std::pair<std::shared_ptr<Frame>, std::future<void>>> saves;
+    size_t maxTilePixels = 0;
+
+    // Per slot: start, upload done, dispatch done, readback done.
+    static const uint32_t timestampsPerSlot = 4;
+    VkQueryPool timestampPool = VK_NULL_HANDLE;
+    uint32_t timestampBits = 0;
+    float timestampPeriod = 1.0f;  // ns per tick
+
+    // Specialised pipelines built on the current device, keyed by shader and
+    // constant tuple, so revisiting a configuration skips driver compilation.
+    std::map<std::pair<std::string, SpecConstants>, VkPipeline> pipelineCache;
+    std::map<std::string, VkShaderModule> shaderModules;
+    // Driver cache behind every pipeline of the run, loaded from and saved
+    // to diskCachePath so later runs skip compilation too.
+    VkPipelineCache diskCache = VK_NULL_HANDLE;
+    std::string diskCachePath;
+    size_t diskCacheLoaded = 0;  // bytes read at startup
+
+    VkInstance instance;
+
+    VkDebugReportCallbackEXT debugReportCallback;
+
+    VkPhysicalDevice physicalDevice;
+
+    VkDevice device;
+
+    VkPipeline pipeline;
+    VkPipeline unpackPipeline = VK_NULL_HANDLE;  // --gpu-convert
+    VkPipeline packPipeline = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout;
+
+    VkCommandPool commandPool;
+    VkCommandBuffer commandBuffer;
+
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet descriptorSet;
+    VkDescriptorSetLayout descriptorSetLayout;
+
+    VkImage image, imageDst;
+    VkImageView imageView;
+    VkSampler sampler;
+    VkDeviceMemory imageMemory;
+    VkBuffer bufferGPU, bufferStaging, bufferDynamic;
+    VkDeviceMemory bufferMemoryGPU, bufferMemoryStaging, bufferMemoryDynamic;
+
+    bool uma = false;
+    // RGBA8 input goes through a 2.2 gamma like stbi_loadf(); cleared by
+    // open(), as the caller's memory is filtered in its own encoding.
+    bool linearize = true;
+    // minImportedHostPointerAlignment, 0 without VK_EXT_external_memory_host
+    VkDeviceSize hostImportAlignment = 0;
+
+    std::vector<const char *> enabledLayers;
+
+    uint32_t queueFamilyIndex;
+    VkQueue queue;
+
+    // Transfer-only family the staging copies run on, uint32_t(-1) when
+    // they share the compute queue.
+    uint32_t transferFamilyIndex = uint32_t(-1);
+    VkQueue transferQueue = VK_NULL_HANDLE;
+    VkCommandPool transferPool = VK_NULL_HANDLE;
+
+    // runImage(): the decoded input and its size
+    float *pixels = nullptr;
+    unsigned char *packedPixels = nullptr;  // --gpu-convert
+    unsigned int imageWidth = 0;
+    unsigned int imageHeight = 0;
+
+    static const char *shaderPath(const FilterParams &a_params)
+    {
+        if (a_params.filter == bilateral) {
+            return a_params.storage == img ? "shaders/bilateral_image.spv"
+                                           : "shaders/bilateral.spv";
+        }
+        if (a_params.storage == img) {
+            return "shaders/nlm_image.spv";
+        }
+        return a_params.nlmParams.kernel == tiled ? "shaders/nlm_tiled.spv"
+                                                  : "shaders/nlm.spv";
+    }
+
+    static PushConstants pushConstants(unsigned int a_width,
+                                       unsigned int a_height)
+    {
+        PushConstants pc = {};
+        pc.width = int(a_width);
+        pc.height = int(a_height);
+        return pc;
+    }
+
+    static SpecConstants specConstants(const FilterParams &a_params)
+    {
+        SpecConstants spec = {};
+        spec.workgroupSize = a_params.workgroupSize;
+        spec.format = int(a_params.format);
+        spec.linearize = VK_TRUE;
+        if (a_params.filter == bilateral) {
+            spec.radius = a_params.bilateralParams.radius;
+            spec.sigma1 = a_params.bilateralParams.sigmaSpatial;
+            spec.sigma2 = a_params.bilateralParams.sigmaRange;
+        }
+        else {
+            spec.radius = a_params.nlmParams.radius;
+            spec.patch = a_params.nlmParams.patch;
+            spec.sigma1 = a_params.nlmParams.sigma;
+            spec.sigma2 = a_params.nlmParams.h;
+        }
+        return spec;
+    }
+
+    // nlm_tiled.comp keeps a (workgroup + 2 * (radius + patch))^2 tile of
+    // vec3 in shared memory. Falls back to the direct kernel when that does
+    // not fit the device limit or the image path is selected.
+    // The integral kernel also runs on storage buffers only.
+    void checkNlmKernel()
+    {
+        if (params.filter != nlm || params.nlmParams.kernel == direct) {
+            return;
+        }
+        if (params.nlmParams.kernel == integral) {
+            params.storage = buf;
+            return;
+        }
+        if (params.storage == img) {
+            if (params.verbose) {
+                std::cout << "tiled NLM kernel needs --storage buf, using the "
+                             "image kernel"
+                          << std::endl;
+            }
+            params.nlmParams.kernel = direct;
+            return;
+        }
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(physicalDevice, &props);
+        const size_t side = size_t(params.workgroupSize) +
+                            2 * size_t(params.nlmParams.radius +
+                                       params.nlmParams.patch);
+        // shared vec3 is laid out with a 16 byte stride on common drivers
+        const size_t sharedBytes = side * side * 4 * sizeof(float);
+        if (sharedBytes > props.limits.maxComputeSharedMemorySize) {
+            if (params.verbose) {
+                std::cout << "tiled NLM kernel needs " << sharedBytes
+                          << " bytes of shared memory, device has "
+                          << props.limits.maxComputeSharedMemorySize
+                          << ", using the direct kernel" << std::endl;
+            }
+            params.nlmParams.kernel = direct;
+        }
+    }
+
+    bool integralNlm() const
+    {
+        return params.filter == nlm && params.nlmParams.kernel == integral;
+    }
+
+    // How far the filter reads around a pixel, the overlap between tiles.
+    unsigned int tileApron() const
+    {
+        if (params.filter == bilateral) {
+            return unsigned(params.bilateralParams.radius);
+        }
+        return unsigned(params.nlmParams.radius + params.nlmParams.patch);
+    }
+
+    // Largest tile region, in pixels, whose buffers fit the storage buffer
+    // range of the device and, over all slots, the memory budget:
+    // --tile-budget MiB, or half of the largest device-local heap.
+    size_t tilePixelLimit() const
+    {
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(physicalDevice, &props);
+        size_t budget = size_t(params.tileBudget) << 20;
+        if (budget == 0) {
+            VkPhysicalDeviceMemoryProperties memoryProps;
+            vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProps);
+            VkDeviceSize heap = 0;
+            for (uint32_t i = 0; i < memoryProps.memoryHeapCount; ++i) {
+                if (memoryProps.memoryHeaps[i].flags &
+                    VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+                    heap = std::max(heap, memoryProps.memoryHeaps[i].size);
+                }
+            }
+            budget = size_t(heap / 2);
+        }
+
+        // see reserveFrame(); prefix is counted as two floats for its
+        // extra row or column
+        const size_t stored = pixelBytes(params.format);
+        const size_t moved = transferBytes();
+        size_t bytesPerPixel = moved + stored;  // upload, output
+        size_t largest = stored;
+        if (!uma) {
+            bytesPerPixel += 2 * moved;  // input, readback
+        }
+        if (params.gpuConvert) {
+            bytesPerPixel += stored + (packResult() ? 4 : 0);  // source, packed
+        }
+        if (integralNlm()) {
+            bytesPerPixel += 3 * sizeof(float) + sizeof(Pixel);
+            largest = sizeof(Pixel);  // the fp32 accumulator
+        }
+        return std::min(budget / (bytesPerPixel * slots.size()),
+                        size_t(props.limits.maxStorageBufferRange) / largest);
+    }
+
+    // Integrated GPUs whose device-local memory is also host visible gain
+    // nothing from staging copies, so they keep the shader on mapped buffers.
+    bool detectUma() const
+    {
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(physicalDevice, &props);
+        if (props.deviceType != VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU &&
+            props.deviceType != VK_PHYSICAL_DEVICE_TYPE_CPU) {
+            return false;
+        }
+        return vk_utils::FindMemoryType(
+                   ~0u,
+                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                   physicalDevice) != uint32_t(-1);
+    }
+
+    // Bytes per pixel of the upload and readback buffers: RGBA8 with
+    // --gpu-convert, the storage format otherwise.
+    size_t transferBytes() const
+    {
+        return params.gpuConvert ? 4 : pixelBytes(params.format);
+    }
+
+    // Format of the buffer that is read back.
+    pixelFormat resultFormat() const
+    {
+        return params.gpuConvert ? rgba8 : params.format;
+    }
+
+    // --gpu-convert needs the pack pass unless output already is RGBA8.
+    bool packResult() const
+    {
+        return params.gpuConvert && params.format != rgba8;
+    }
+
+    // Image format matching the buffer layout of a_format.
+    static VkFormat imageFormat(pixelFormat a_format)
+    {
+        switch (a_format) {
+        case rgba16f:
+            return VK_FORMAT_R16G16B16A16_SFLOAT;
+        case rgba8:
+            return VK_FORMAT_R8G8B8A8_UNORM;
+        default:
+            return VK_FORMAT_R32G32B32A32_SFLOAT;
+        }
+    }
+
+    static VkMemoryPropertyFlags hostMemory()
+    {
+        return VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    }
+
+    // Memory of buffers and images only the GPU touches.
+    VkMemoryPropertyFlags workingMemory() const
+    {
+        return uma ? hostMemory() : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    }
+
+    // Returns the pipeline for (shader, constants), compiling it on a miss.
+    VkPipeline getPipeline(const char *a_shaderPath,
+                           const SpecConstants &a_spec)
+    {
+        auto key = std::make_pair(std::string(a_shaderPath), a_spec);
+        auto it = pipelineCache.find(key);
+        if (it != pipelineCache.end()) {
+            return it->second;
+        }
+
+        VkShaderModule &module = shaderModules[key.first];
+        if (module == VK_NULL_HANDLE) {
+            module = vk_utils::CreateShaderModule(
+                device, vk_utils::ReadFile(a_shaderPath));
+        }
+
+        VkPipeline newPipeline;
+        createComputePipeline(device, module, pipelineLayout, a_spec,
+                              diskCache, &newPipeline);
+        pipelineCache[key] = newPipeline;
+        return newPipeline;
+    }
+
+    // --pipeline-cache, else $XDG_CACHE_HOME or ~/.cache + /vulkan_filter;
+    // empty when caching is off or there is no home.
+    std::string pipelineCacheDir() const
+    {
+        if (params.pipelineCache == "off") {
+            return std::string();
+        }
+        if (!params.pipelineCache.empty()) {
+            return params.pipelineCache;
+        }
+        const char *xdg = getenv("XDG_CACHE_HOME");
+        if (xdg && *xdg) {
+            return std::string(xdg) + "/vulkan_filter";
+        }
+        const char *home = getenv("HOME");
+        if (home && *home) {
+            return std::string(home) + "/.cache/vulkan_filter";
+        }
+        return std::string();
+    }
+
+    // Creates diskCache, seeded from the file of this device and driver
+    // version when an earlier run left one. Without a directory the cache
+    // still serves the pipelines of this run.
+    void openPipelineCache()
+    {
+        const std::string dir = pipelineCacheDir();
+        diskCachePath = dir.empty()
+                        ? std::string()
+                        : vk_utils::PipelineCachePath(physicalDevice, dir);
+        diskCache = vk_utils::CreatePipelineCache(
+            device, physicalDevice, diskCachePath, &diskCacheLoaded);
+        if (diskCacheLoaded > 0 && params.verbose) {
+            std::cout << "pipeline cache: " << diskCachePath << std::endl;
+        }
+    }
+
+    // Saves diskCache when this run compiled something new, then destroys
+    // it. Failing to save only costs the next run its head start.
+    void closePipelineCache()
+    {
+        if (diskCache == VK_NULL_HANDLE) {
+            return;
+        }
+        size_t size = 0;
+        VK_CHECK_RESULT(
+            vkGetPipelineCacheData(device, diskCache, &size, nullptr));
+        if (!diskCachePath.empty() && size > diskCacheLoaded) {
+            const std::string dir =
+                diskCachePath.substr(0, diskCachePath.rfind('/'));
+            const size_t parent = dir.rfind('/');
+            if (parent != std::string::npos && parent > 0) {
+                mkdir(dir.substr(0, parent).c_str(), 0755);
+            }
+            mkdir(dir.c_str(), 0755);
+            if (!vk_utils::SavePipelineCache(device, diskCache,
+                                             diskCachePath) &&
+                params.verbose) {
+                std::cout << "could not save the pipeline cache to "
+                          << diskCachePath << std::endl;
+            }
+        }
+        vkDestroyPipelineCache(device, diskCache, NULL);
+        diskCache = VK_NULL_HANDLE;
+    }
+
+    void destroyPipelines()
+    {
+        for (auto &entry : pipelineCache) {
+            vkDestroyPipeline(device, entry.second, NULL);
+        }
+        for (auto &entry : shaderModules) {
+            vkDestroyShaderModule(device, entry.second, NULL);
+        }
+        pipelineCache.clear();
+        closePipelineCache();
+        shaderModules.clear();
+    }
+
+public:
+    void run(const FilterParams &a_params)
+    {
+        params = a_params;
+        if (!params.batch.empty() && params.storage == img) {
+            if (params.verbose) {
+                std::cout << "batch mode runs on storage buffers" << std::endl;
+            }
+            params.storage = buf;
+        }
+        if (params.gpuConvert && params.storage == img) {
+            if (params.verbose) {
+                std::cout << "--gpu-convert runs on storage buffers"
+                          << std::endl;
+            }
+            params.storage = buf;
+        }
+        if (isRawFrameFile(params.input) && params.storage == img) {
+            if (params.verbose) {
+                std::cout << "raw frames run on storage buffers" << std::endl;
+            }
+            params.storage = buf;
+        }
+        const auto setupStart = std::chrono::steady_clock::now();
+        init();
+        if (params.storage == img) {
+            runImage();
+            return;
+        }
+
+        if (params.verbose) {
+            std::cout << "creating resources ... " << std::endl;
+        }
+        createFrameObjects();
+        const double setupMs = elapsedMs(setupStart);
+
+        std::vector<std::string> inputs(1, params.input);
+        std::vector<std::string> outputs(1, params.output);
+        if (!params.batch.empty()) {
+            inputs = listBatchInputs(params.batch);
+            outputs = batchOutputPaths(params.outputDir, inputs,
+                                       params.outputExt);
+            if (params.verbose) {
+                std::cout << inputs.size() << " images in " << params.batch
+                          << std::endl;
+            }
+        }
+        BatchStats stats(params.verbose);
+        const auto start = std::chrono::steady_clock::now();
+        codecs.reset(new CodecPool(params.codecThreads));
+        processFrames(inputs, outputs, stats);
+        codecs.reset();
+        stats.report(setupMs, elapsedMs(start), int(slots.size()));
+
+        if (params.verbose) {
+            std::cout << "destroying all     ... " << std::endl;
+        }
+        cleanup();
+        if (params.batch.empty() && stats.failures() > 0) {
+            throw std::runtime_error("failed to load " + params.input);
+        }
+    }
+
+    // Creates the device and the buffer path objects for a_params once, so
+    // filter() only reserves buffers and records commands. The sampled
+    // image path (--storage img) is left to run().
+    void open(const FilterParams &a_params)
+    {
+        params = a_params;
+        params.storage = buf;
+        openKernel = a_params.nlmParams.kernel;
+        linearize = false;
+        init();
+        createFrameObjects();
+    }
+
+    // Filters the caller's a_width x a_height RGBA8 rows at a_src into
+    // a_dst and returns when a_dst is written. The filter, kernel, format
+    // and the other settings of the device stay those of open(); only
+    // a_params' bilateral and NLM parameters are taken, compiling a
+    // pipeline the first time a combination is seen.
+    void filter(const unsigned char *a_src, size_t a_srcStride,
+                unsigned char *a_dst, size_t a_dstStride,
+                unsigned int a_width, unsigned int a_height,
+                const FilterParams &a_params)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        params.bilateralParams = a_params.bilateralParams;
+        params.nlmParams = a_params.nlmParams;
+        params.nlmParams.kernel = openKernel;
+        checkNlmKernel();
+        if (!integralNlm()) {
+            pipeline = getPipeline(shaderPath(params), specConstants(params));
+        }
+
+        std::shared_ptr<Frame> frame = std::make_shared<Frame>();
+        frame->packed = a_src;
+        frame->packedStride = a_srcStride;
+        frame->width = a_width;
+        frame->height = a_height;
+        frame->inputName = "memory";
+        frame->result = a_dst;
+        frame->resultStride = a_dstStride;
+        frame->tiles = splitIntoTiles(a_width, a_height, tileApron(),
+                                      maxTilePixels);
+        frame->tilesLeft = frame->tiles.size();
+        frame->times.load = elapsedMs(start);
+
+        BatchStats stats(params.verbose);
+        submitTiles(frame, stats);
+        drainSlots(stats);
+    }
+
+    void close() { cleanup(); }
+
+private:
+    void init()
+    {
+        const int deviceId = 0;
+        if (params.verbose) {
+            std::cout << "init vulkan for device " << deviceId << " ... "
+                      << std::endl;
+        }
+
+        uint32_t instanceVersion = VK_API_VERSION_1_0;
+        instance = vk_utils::CreateInstance(enableValidationLayers,
+                                            enabledLayers,
+                                            std::vector<const char *>(),
+                                            &instanceVersion);
+
+        if (enableValidationLayers) {
+            vk_utils::InitDebugReportCallback(instance, &debugReportCallbackFn,
+                                              &debugReportCallback);
+        }
+
+        physicalDevice = vk_utils::FindPhysicalDevice(instance, params.verbose,
+                                                     deviceId);
+
+        queueFamilyIndex = vk_utils::GetComputeQueueFamilyIndex(physicalDevice);
+        uma = detectUma();
+
+        // Only the buffer path with staging copies has anything to move.
+        std::vector<uint32_t> families(1, queueFamilyIndex);
+        transferFamilyIndex = uint32_t(-1);
+        if (params.transferQueue && !uma && params.storage == buf) {
+            transferFamilyIndex =
+                vk_utils::GetTransferQueueFamilyIndex(physicalDevice);
+        }
+        if (transferFamilyIndex != uint32_t(-1)) {
+            families.push_back(transferFamilyIndex);
+        }
+
+        std::vector<const char *> extensions;
+        hostImportAlignment =
+            vk_utils::HostImportAlignment(physicalDevice, instanceVersion);
+        if (hostImportAlignment != 0) {
+            extensions.push_back(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+        }
+        device = vk_utils::CreateLogicalDevice(families, physicalDevice,
+                                               enabledLayers, extensions);
+
+        vkGetDeviceQueue(device, queueFamilyIndex, 0, &queue);
+        if (transferFamilyIndex != uint32_t(-1)) {
+            vkGetDeviceQueue(device, transferFamilyIndex, 0, &transferQueue);
+        }
+        openPipelineCache();
+        checkNlmKernel();
+        if (!params.verbose) {
+            return;
+        }
+        std::cout << (uma ? "memory: host visible (UMA)"
+                          : "memory: device local with staging copies")
+                  << std::endl;
+        if (transferQueue != VK_NULL_HANDLE) {
+            std::cout << "copies: transfer queue family "
+                      << transferFamilyIndex << std::endl;
+        }
+        if (hostImportAlignment != 0) {
+            std::cout << "caller memory: imported, aligned to "
+                      << hostImportAlignment << " bytes" << std::endl;
+        }
+    }
+
+    // Everything of the buffer path that does not depend on the image size,
+    // created once per run: layouts, pipelines and the slots' descriptor
+    // sets, command buffers and fences.
+    void createFrameObjects()
+    {
+        slots.resize(std::max(params.inFlight, 1));
+        const uint32_t slotCount = uint32_t(slots.size());
+        const uint32_t bindings = params.gpuConvert ? 7
+                                  : integralNlm()   ? 5
+                                                    : 2;
+        createStorageDescriptorSetLayout(device, bindings,
+                                         &descriptorSetLayout);
+        createPipelineLayout(device, descriptorSetLayout, &pipelineLayout);
+
+        std::vector<VkDescriptorSet> sets(slotCount);
+        std::vector<VkCommandBuffer> commandBuffers(slotCount);
+        allocateDescriptorSets(device, bindings, slotCount,
+                               descriptorSetLayout, &descriptorPool,
+                               sets.data());
+        createCommandPool(device, queueFamilyIndex, &commandPool);
+        allocateCommandBuffers(device, commandPool, slotCount,
+                               commandBuffers.data());
+        for (uint32_t i = 0; i < slotCount; ++i) {
+            VkFenceCreateInfo fenceCreateInfo = {};
+            fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, NULL,
+                                          &slots[i].fence));
+            slots[i].descriptorSet = sets[i];
+            slots[i].commandBuffer = commandBuffers[i];
+            slots[i].index = i;
+        }
+        if (transferQueue != VK_NULL_HANDLE) {
+            createTransferObjects();
+        }
+        createTimestampPool(timestampsPerSlot * slotCount);
+
+        if (params.verbose) {
+            std::cout << "compiling shaders  ... " << std::endl;
+        }
+        if (integralNlm()) {
+            VkPipeline rows, cols, norm;
+            integralPipelines(rows, cols, norm);
+        }
+        else {
+            pipeline = getPipeline(shaderPath(params), specConstants(params));
+        }
+        if (params.gpuConvert) {
+            SpecConstants unpackSpec = specConstants(params);
+            unpackSpec.linearize = linearize ? VK_TRUE : VK_FALSE;
+            unpackPipeline = getPipeline("shaders/unpack_rgba8.spv",
+                                         unpackSpec);
+            packPipeline = getPipeline("shaders/pack_rgba8.spv",
+                                       specConstants(params));
+        }
+
+        maxTilePixels = tilePixelLimit();
+    }
+
+    // Command buffers for the copies of every slot on the transfer queue
+    // and the semaphores ordering them around the dispatch.
+    void createTransferObjects()
+    {
+        const uint32_t slotCount = uint32_t(slots.size());
+        std::vector<VkCommandBuffer> commandBuffers(2 * slotCount);
+        createCommandPool(device, transferFamilyIndex, &transferPool);
+        allocateCommandBuffers(device, transferPool, 2 * slotCount,
+                               commandBuffers.data());
+        for (uint32_t i = 0; i < slotCount; ++i) {
+            VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+            semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo,
+                                              NULL, &slots[i].uploaded));
+            VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo,
+                                              NULL, &slots[i].filtered));
+            slots[i].uploadCommands = commandBuffers[2 * i];
+            slots[i].readbackCommands = commandBuffers[2 * i + 1];
+        }
+    }
+
+    // Timestamps between the upload, dispatch and readback of each slot give
+    // the GPU time of those phases without stalling the ring. Skipped when
+    // the queue family has no timestamp support. With a transfer queue the
+    // copies run outside of the compute queue and only the dispatch is
+    // measured; the upload and readback phases are just the ownership
+    // barriers then and are reported as unknown (FrameTimes::copiesTimed).
+    void createTimestampPool(uint32_t a_queryCount)
+    {
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount,
+                                                 NULL);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount,
+                                                 families.data());
+        timestampBits = families[queueFamilyIndex].timestampValidBits;
+        if (timestampBits == 0) {
+            return;
+        }
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(physicalDevice, &props);
+        timestampPeriod = props.limits.timestampPeriod;
+
+        VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+        queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolCreateInfo.queryCount = a_queryCount;
+        VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolCreateInfo, NULL,
+                                          &timestampPool));
+    }
+
+    // Runs a_inputs through the ring of slots, one tile per slot; images
+    // within the memory budget are a single tile. Tile i goes to slot
+    // i % slots.size() once that slot's previous tile has been stored, so
+    // with two slots the host decodes and encodes while the GPU filters.
+    // Decoding happens before the wait to keep it off the critical path.
+    // The codec workers decode up to codecLookahead() inputs ahead of the
+    // one whose tiles are being submitted, and write the results behind it
+    // (retireFrame()), so the GPU is fed from this thread alone.
+    void processFrames(const std::vector<std::string> &a_inputs,
+                       const std::vector<std::string> &a_outputs,
+                       BatchStats &a_stats)
+    {
+        const size_t ahead = codecLookahead();
+        std::deque<std::future<std::shared_ptr<Frame>>> decoded;
+        size_t queued = 0;
+        for (size_t i = 0; i < a_inputs.size(); ++i) {
+            for (; queued < a_inputs.size() && queued <= i + ahead; ++queued) {
+                const std::string input = a_inputs[queued];
+                const std::string output = a_outputs[queued];
+                decoded.push_back(codecs->submit([this, input, output]() {
+                    return decodeFrame(input, output);
+                }));
+            }
+            std::shared_ptr<Frame> frame =
+                loadFrame(decoded.front().get(), a_stats);
+            decoded.pop_front();
+            if (!frame) {
+                continue;
+            }
+            submitTiles(frame, a_stats);
+            stbi_image_free(frame->pixels);
+            stbi_image_free((void *)frame->packed);
+            frame->pixels = nullptr;
+            frame->packed = nullptr;
+            frame->raw.reset();
+        }
+        drainSlots(a_stats);
+        finishSaves(a_stats, 0);
+    }
+
+    // Whole frames decoded ahead or waiting to be written, each. A decoded
+    // RGBA32F frame is 16 bytes per pixel, so this follows the ring of
+    // slots rather than the number of workers: more would hold frames the
+    // GPU cannot take yet and undo the memory bound of the tiling.
+    size_t codecLookahead() const
+    {
+        return std::min(size_t(codecs->size()), slots.size());
+    }
+
+    // Submits every tile of a_frame to the next slots of the ring.
+    void submitTiles(const std::shared_ptr<Frame> &a_frame,
+                     BatchStats &a_stats)
+    {
+        for (size_t t = 0; t < a_frame->tiles.size(); ++t, ++nextSlot) {
+            FrameSlot &slot = slots[nextSlot % slots.size()];
+            if (slot.pending) {
+                retireFrame(slot, a_stats);
+            }
+            submitFrame(slot, a_frame, a_frame->tiles[t]);
+        }
+    }
+
+    // Retires the tiles still in flight, oldest first.
+    void drainSlots(BatchStats &a_stats)
+    {
+        for (size_t i = 0; i < slots.size(); ++i, ++nextSlot) {
+            FrameSlot &slot = slots[nextSlot % slots.size()];
+            if (slot.pending) {
+                retireFrame(slot, a_stats);
+            }
+        }
+    }
+
+    // Decodes a_input, to be written to a_output, on a codec worker:
+    // RGBA32F, RGBA8 with --gpu-convert, or a mapping of a raw frame.
+    // Reads nothing but params, so several run at once; a failure is left
+    // in the frame's error.
+    std::shared_ptr<Frame> decodeFrame(const std::string &a_input,
+                                       const std::string &a_output) const
+    {
+        const auto start = std::chrono::steady_clock::now();
+        std::shared_ptr<Frame> frame = std::make_shared<Frame>();
+        frame->inputName = a_input;
+        frame->outputName = a_output;
+        if (isRawFrameFile(a_input)) {
+            try {
+                frame->raw = std::make_shared<RawFrame>(a_input);
+            }
+            catch (const std::runtime_error &e) {
+                frame->error = e.what();
+                return frame;
+            }
+            frame->width = frame->raw->width();
+            frame->height = frame->raw->height();
+        }
+        else {
+            int width = 0, height = 0, texChannels;
+            if (params.gpuConvert) {
+                frame->packed = stbi_load(a_input.c_str(), &width, &height,
+                                          &texChannels, STBI_rgb_alpha);
+            }
+            else {
+                frame->pixels = stbi_loadf(a_input.c_str(), &width, &height,
+                                           &texChannels, STBI_rgb_alpha);
+            }
+            if (!frame->pixels && !frame->packed) {
+                const char *reason = stbi_failure_reason();
+                frame->error = reason ? reason : "decode failed";
+                return frame;
+            }
+            frame->width = unsigned(width);
+            frame->height = unsigned(height);
+            frame->packedStride = 4 * size_t(width);
+        }
+        frame->times.load = elapsedMs(start);
+        return frame;
+    }
+
+    // Splits the decoded a_frame into tiles and gives it its result, or
+    // records why it could not be decoded and returns null.
+    std::shared_ptr<Frame> loadFrame(const std::shared_ptr<Frame> &a_frame,
+                                     BatchStats &a_stats)
+    {
+        if (!a_frame->error.empty()) {
+            a_stats.addFailure(a_frame->inputName, a_frame->error);
+            return std::shared_ptr<Frame>();
+        }
+        const auto start = std::chrono::steady_clock::now();
+        Frame &frame = *a_frame;
+        frame.tiles = splitIntoTiles(frame.width, frame.height, tileApron(),
+                                     maxTilePixels);
+        frame.tilesLeft = frame.tiles.size();
+        if (uncompressedFormatOf(frame.outputName) != notUncompressed) {
+            frame.writer = std::make_shared<UncompressedWriter>(
+                frame.outputName, frame.width, frame.height);
+        }
+        else {
+            frame.resultStorage.resize(size_t(frame.width) * frame.height *
+                                       4);
+            frame.result = &frame.resultStorage[0];
+            frame.resultStride = 4 * size_t(frame.width);
+        }
+        if (frame.tiles.size() > 1 && params.verbose) {
+            std::cout << frame.inputName << ": " << frame.tiles.size()
+                      << " tiles of up to " << frame.tiles[0].width << "x"
+                      << frame.tiles[0].height << std::endl;
+        }
+        frame.times.load += elapsedMs(start);
+        return a_frame;
+    }
+
+    // Fills slot with a_tile of the decoded a_frame and submits it without
+    // waiting.
+    void submitFrame(FrameSlot &a_slot, const std::shared_ptr<Frame> &a_frame,
+                     const Tile &a_tile)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        a_slot.frame = a_frame;
+        a_slot.tile = a_tile;
+        a_slot.width = a_tile.width;
+        a_slot.height = a_tile.height;
+        reserveFrame(a_slot);
+        importCallerMemory(a_slot);
+        if (a_slot.hostSource.buffer == VK_NULL_HANDLE) {
+            uploadTile(a_slot);
+        }
+        recordFrame(a_slot);
+
+        if (transferQueue != VK_NULL_HANDLE) {
+            submitWithTransferQueue(a_slot);
+        }
+        else {
+            VkSubmitInfo submitInfo = {};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &a_slot.commandBuffer;
+            VK_CHECK_RESULT(
+                vkQueueSubmit(queue, 1, &submitInfo, a_slot.fence));
+        }
+
+        a_frame->times.load += elapsedMs(start);
+        a_slot.pending = true;
+    }
+
+    // Converts the region of the slot's tile into its upload buffer in the
+    // storage format, in one piece when the tile spans whole rows. With
+    // --gpu-convert RGBA8 is copied as it is; RGBA8 from the caller is
+    // scaled to [0, 1] without gamma otherwise. Raw frames are converted row by
+    // row straight out of their mapping.
+    void uploadTile(const FrameSlot &a_slot)
+    {
+        const Frame &frame = *a_slot.frame;
+        const Tile &tile = a_slot.tile;
+        const size_t rowBytes = transferBytes() * tile.width;
+        void *data = a_slot.upload.mapped;
+        if (frame.raw) {
+            std::vector<float> linear(4 * size_t(tile.width));
+            for (unsigned int i = 0; i < tile.height; ++i) {
+                char *dst = (char *)data + rowBytes * i;
+                if (params.gpuConvert) {
+                    frame.raw->toRgba8(tile.y + i, tile.x, tile.width,
+                                       (unsigned char *)dst);
+                }
+                else {
+                    frame.raw->toLinear(tile.y + i, tile.x, tile.width,
+                                        &linear[0]);
+                    packPixels(&linear[0], tile.width, params.format, dst);
+                }
+            }
+            return;
+        }
+        if (frame.packed) {
+            const unsigned char *src =
+                frame.packed + frame.packedStride * tile.y + 4 * tile.x;
+            std::vector<float> rgba;
+            if (!params.gpuConvert) {
+                rgba.resize(4 * size_t(tile.width));
+            }
+            for (unsigned int i = 0; i < tile.height; ++i) {
+                const unsigned char *row = src + frame.packedStride * i;
+                char *dst = (char *)data + rowBytes * i;
+                if (params.gpuConvert) {
+                    memcpy(dst, row, rowBytes);
+                }
+                else {
+                    rgba8ToFloat(row, tile.width, &rgba[0]);
+                    packPixels(&rgba[0], tile.width, params.format, dst);
+                }
+            }
+            return;
+        }
+        const float *src =
+            frame.pixels + 4 * (size_t(frame.width) * tile.y + tile.x);
+        if (tile.width == frame.width) {
+            packPixels(src, size_t(tile.width) * tile.height, params.format,
+                       data);
+        }
+        else {
+            for (unsigned int i = 0; i < tile.height; ++i) {
+                packPixels(src + 4 * size_t(frame.width) * i, tile.width,
+                           params.format, (char *)data + rowBytes * i);
+            }
+        }
+    }
+
+    // Imports the caller's memory behind a_slot's tile so neither side goes
+    // through a memcpy: the source when it already is the RGBA8 upload of
+    // --gpu-convert, the destination when the result is RGBA8. Only for
+    // filter() frames in one tile with packed rows and aligned pointers;
+    // each side falls back to the copy on its own.
+    void importCallerMemory(FrameSlot &a_slot)
+    {
+        const Frame &frame = *a_slot.frame;
+        if (hostImportAlignment == 0 || !frame.outputName.empty() ||
+            a_slot.tile.width != frame.width ||
+            a_slot.tile.height != frame.height) {
+            return;
+        }
+        const size_t rowBytes = 4 * size_t(frame.width);
+        const size_t size = rowBytes * frame.height;
+        if (params.gpuConvert && frame.packedStride == rowBytes) {
+            importHostBuffer(a_slot.hostSource, (void *)frame.packed, size,
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+        }
+        if (resultFormat() == rgba8 && frame.resultStride == rowBytes) {
+            importHostBuffer(a_slot.hostResult, frame.result, size,
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                 VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+        }
+        if (uma) {
+            bindTransferBuffers(a_slot, a_slot.hostSource.buffer,
+                                a_slot.hostResult.buffer);
+        }
+    }
+
+    // Drops the imports of a_slot once its tile has retired and puts the
+    // slot's own buffers back into its descriptor set.
+    void releaseCallerMemory(FrameSlot &a_slot)
+    {
+        if (a_slot.hostSource.buffer == VK_NULL_HANDLE &&
+            a_slot.hostResult.buffer == VK_NULL_HANDLE) {
+            return;
+        }
+        if (uma) {
+            bindTransferBuffers(
+                a_slot,
+                a_slot.hostSource.buffer != VK_NULL_HANDLE
+                    ? a_slot.upload.buffer
+                    : VK_NULL_HANDLE,
+                a_slot.hostResult.buffer != VK_NULL_HANDLE
+                    ? result(a_slot).buffer
+                    : VK_NULL_HANDLE);
+        }
+        destroyDeviceBuffer(a_slot.hostSource);
+        destroyDeviceBuffer(a_slot.hostResult);
+    }
+
+    // Points the bindings the shaders read the upload from and write the
+    // result to at a_source and a_result; VK_NULL_HANDLE leaves one as is.
+    void bindTransferBuffers(const FrameSlot &a_slot, VkBuffer a_source,
+                             VkBuffer a_result)
+    {
+        std::vector<VkBuffer> buffers(params.gpuConvert ? 7 : 2,
+                                      VK_NULL_HANDLE);
+        buffers[params.gpuConvert ? 5 : 0] = a_source;
+        buffers[packResult() ? 6 : 1] = a_result;
+        updateDescriptorSetBuffers(device, a_slot.descriptorSet, buffers);
+    }
+
+    // Imports a_size bytes at a_pointer into a_buffer. The import is
+    // rounded up to hostImportAlignment, so it is only tried when that
+    // stays within the pages a_pointer .. a_pointer + a_size touch.
+    bool importHostBuffer(DeviceBuffer &a_buffer, void *a_pointer,
+                          size_t a_size, VkBufferUsageFlags a_usage)
+    {
+        const size_t alignment = size_t(hostImportAlignment);
+        const size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+        const size_t size = (a_size + alignment - 1) / alignment * alignment;
+        if (uintptr_t(a_pointer) % alignment != 0 ||
+            size > (a_size + pageSize - 1) / pageSize * pageSize) {
+            return false;
+        }
+        return vk_utils::ImportHostMemory(device, physicalDevice, a_pointer,
+                                          size, a_usage, &a_buffer.buffer,
+                                          &a_buffer.memory);
+    }
+
+    // Upload on the transfer queue, dispatch on the compute queue, readback
+    // on the transfer queue again. The upload of the next image and the
+    // readback of the previous one overlap this dispatch on the copy engine.
+    // The fence is signalled by the readback, the last of the three.
+    void submitWithTransferQueue(FrameSlot &a_slot)
+    {
+        VkSubmitInfo uploadInfo = {};
+        uploadInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        uploadInfo.commandBufferCount = 1;
+        uploadInfo.pCommandBuffers = &a_slot.uploadCommands;
+        uploadInfo.signalSemaphoreCount = 1;
+        uploadInfo.pSignalSemaphores = &a_slot.uploaded;
+        VK_CHECK_RESULT(
+            vkQueueSubmit(transferQueue, 1, &uploadInfo, VK_NULL_HANDLE));
+
+        // all stages, so the first timestamp is not taken before the upload
+        const VkPipelineStageFlags filterWait =
+            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        VkSubmitInfo filterInfo = {};
+        filterInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        filterInfo.waitSemaphoreCount = 1;
+        filterInfo.pWaitSemaphores = &a_slot.uploaded;
+        filterInfo.pWaitDstStageMask = &filterWait;
+        filterInfo.commandBufferCount = 1;
+        filterInfo.pCommandBuffers = &a_slot.commandBuffer;
+        filterInfo.signalSemaphoreCount = 1;
+        filterInfo.pSignalSemaphores = &a_slot.filtered;
+        VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &filterInfo, VK_NULL_HANDLE));
+
+        const VkPipelineStageFlags readbackWait =
+            VK_PIPELINE_STAGE_TRANSFER_BIT;
+        VkSubmitInfo readbackInfo = {};
+        readbackInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        readbackInfo.waitSemaphoreCount = 1;
+        readbackInfo.pWaitSemaphores = &a_slot.filtered;
+        readbackInfo.pWaitDstStageMask = &readbackWait;
+        readbackInfo.commandBufferCount = 1;
+        readbackInfo.pCommandBuffers = &a_slot.readbackCommands;
+        VK_CHECK_RESULT(
+            vkQueueSubmit(transferQueue, 1, &readbackInfo, a_slot.fence));
+    }
+
+    // Waits for the tile in slot, stores its core and frees the slot. The
+    // last tile of a frame hands the image to a codec worker to be written.
+    void retireFrame(FrameSlot &a_slot, BatchStats &a_stats)
+    {
+        Frame &frame = *a_slot.frame;
+        auto start = std::chrono::steady_clock::now();
+        VK_CHECK_RESULT(vkWaitForFences(device, 1, &a_slot.fence, VK_TRUE,
+                                        100000000000));
+        VK_CHECK_RESULT(vkResetFences(device, 1, &a_slot.fence));
+        frame.times.wait += elapsedMs(start);
+        double phases[timestampsPerSlot - 1];
+        timestampDeltasMs(timestampsPerSlot * a_slot.index,
+                          timestampsPerSlot - 1, phases);
+        frame.times.gpuDispatch += phases[1];
+        if (transferQueue != VK_NULL_HANDLE) {
+            // phases 0 and 2 only cover the ownership barriers
+            frame.times.copiesTimed = false;
+            frame.times.gpu += phases[1];
+        }
+        else {
+            frame.times.gpuUpload += phases[0];
+            frame.times.gpuReadback += phases[2];
+            frame.times.gpu += phases[0] + phases[1] + phases[2];
+        }
+
+        start = std::chrono::steady_clock::now();
+        if (a_slot.hostResult.buffer == VK_NULL_HANDLE) {
+            storeTile(uma ? result(a_slot).mapped : a_slot.readback.mapped,
+                      a_slot.tile, frame);
+        }
+        releaseCallerMemory(a_slot);
+        frame.times.readback += elapsedMs(start);
+        const bool last = --frame.tilesLeft == 0;
+        if (last && frame.writer) {
+            start = std::chrono::steady_clock::now();
+            frame.writer->close();
+            frame.writer.reset();
+            frame.times.save = elapsedMs(start);
+            a_stats.add(frame.inputName, frame.width, frame.height,
+                        frame.times);
+            if (!params.profile.empty()) {
+                appendProfile(params.profile, frame.inputName, frame.width,
+                              frame.height, frame.times);
+            }
+        }
+        else if (last && !frame.outputName.empty()) {
+            std::shared_ptr<Frame> done = a_slot.frame;
+            saves.push_back(std::make_pair(done, codecs->submit([done]() {
+                const auto start = std::chrono::steady_clock::now();
+                writeImage(done->outputName, done->width, done->height,
+                           done->result);
+                done->times.save = elapsedMs(start);
+            })));
+            finishSaves(a_stats, codecLookahead());
+        }
+        else if (last && !params.profile.empty()) {
+            appendProfile(params.profile, frame.inputName, frame.width,
+                          frame.height, frame.times);
+        }
+        a_slot.pending = false;
+        a_slot.frame.reset();
+    }
+
+    // Waits for the oldest writes until at most a_pending are left, which
+    // bounds the results held in memory, and accounts for the written
+    // images in input order.
+    void finishSaves(BatchStats &a_stats, size_t a_pending)
+    {
+        while (saves.size() > a_pending) {
+            std::shared_ptr<Frame> frame = saves.front().first;
+            saves.front().second.get();
+            saves.pop_front();
+            a_stats.add(frame->inputName, frame->width, frame->height,
+                        frame->times);
+            if (!params.profile.empty()) {
+                appendProfile(params.profile, frame->inputName, frame->width,
+                              frame->height, frame->times);
+            }
+        }
+    }
+
+    // Converts the core of a_tile from the filtered region at a_data, the
+    // mapped readback memory, to RGBA8 at its place in a_frame.result, or
+    // through a band of rows into the file of a_frame.writer.
+    void storeTile(const void *a_data, const Tile &a_tile,
+                   Frame &a_frame) const
+    {
+        const size_t stored = transferBytes();
+        const char *src =
+            (const char *)a_data +
+            stored * (size_t(a_tile.width) * (a_tile.coreY - a_tile.y) +
+                      (a_tile.coreX - a_tile.x));
+        if (a_frame.writer) {
+            const size_t rowBytes = 4 * size_t(a_tile.coreWidth);
+            const unsigned int bandRows = unsigned(std::max<size_t>(
+                1, std::min<size_t>(a_tile.coreHeight,
+                                    (size_t(4) << 20) / rowBytes)));
+            std::vector<unsigned char> band(rowBytes * bandRows);
+            for (unsigned int y = 0; y < a_tile.coreHeight; y += bandRows) {
+                const unsigned int rows =
+                    std::min(bandRows, a_tile.coreHeight - y);
+                unpackRowsToRgba8(src + stored * a_tile.width * y,
+                                  stored * a_tile.width, a_tile.coreWidth,
+                                  rows, resultFormat(), &band[0], rowBytes,
+                                  params.threads);
+                a_frame.writer->writeRegion(a_tile.coreX, a_tile.coreY + y,
+                                            a_tile.coreWidth, rows, &band[0],
+                                            rowBytes);
+            }
+            return;
+        }
+        unsigned char *dst = a_frame.result +
+                             a_frame.resultStride * a_tile.coreY +
+                             4 * size_t(a_tile.coreX);
+        unpackRowsToRgba8(src, stored * a_tile.width, a_tile.coreWidth,
+                          a_tile.coreHeight, resultFormat(), dst,
+                          a_frame.resultStride, params.threads);
+    }
+
+    void recordFrame(const FrameSlot &a_slot)
+    {
+        VkCommandBuffer cmd = a_slot.commandBuffer;
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        VK_CHECK_RESULT(vkBeginCommandBuffer(cmd, &beginInfo));
+        const uint32_t query = timestampsPerSlot * a_slot.index;
+        if (timestampPool != VK_NULL_HANDLE) {
+            vkCmdResetQueryPool(cmd, timestampPool, query, timestampsPerSlot);
+        }
+        writeTimestamp(cmd, timestampPool, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       query);
+
+        const StagingCopies copies = stagingCopies(a_slot);
+        const PushConstants pc = pushConstants(a_slot.width, a_slot.height);
+        recordUpload(cmd, copies);
+        writeTimestamp(cmd, timestampPool,
+                       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query + 1);
+        if (params.gpuConvert) {
+            recordCommandsTo(cmd, unpackPipeline, pipelineLayout,
+                             a_slot.descriptorSet, pc, params.workgroupSize);
+            computeBarrier(cmd, VK_ACCESS_SHADER_WRITE_BIT,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        }
+        if (integralNlm()) {
+            recordIntegralNlmTo(cmd, a_slot);
+        }
+        else {
+            recordCommandsTo(cmd, pipeline, pipelineLayout,
+                             a_slot.descriptorSet, pc, params.workgroupSize);
+        }
+        if (packResult()) {
+            computeBarrier(cmd, VK_ACCESS_SHADER_WRITE_BIT,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            recordCommandsTo(cmd, packPipeline, pipelineLayout,
+                             a_slot.descriptorSet, pc, params.workgroupSize);
+        }
+        writeTimestamp(cmd, timestampPool,
+                       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query + 2);
+        recordReadback(cmd, copies);
+        writeTimestamp(cmd, timestampPool,
+                       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query + 3);
+        VK_CHECK_RESULT(vkEndCommandBuffer(cmd));
+
+        if (transferQueue != VK_NULL_HANDLE) {
+            recordTransfers(a_slot, copies);
+        }
+    }
+
+    // The transfer queue halves of recordUpload and recordReadback.
+    static void recordTransfers(const FrameSlot &a_slot,
+                                const StagingCopies &a_copies)
+    {
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        VK_CHECK_RESULT(vkBeginCommandBuffer(a_slot.uploadCommands, &beginInfo));
+        recordUploadCopy(a_slot.uploadCommands, a_copies);
+        VK_CHECK_RESULT(vkEndCommandBuffer(a_slot.uploadCommands));
+
+        VK_CHECK_RESULT(
+            vkBeginCommandBuffer(a_slot.readbackCommands, &beginInfo));
+        recordReadbackCopy(a_slot.readbackCommands, a_copies);
+        VK_CHECK_RESULT(vkEndCommandBuffer(a_slot.readbackCommands));
+    }
+
+    // Milliseconds between consecutive timestamps a_first .. a_first +
+    // a_count of completed commands into a_ms[0 .. a_count - 1], zeros
+    // without timestamp support.
+    void timestampDeltasMs(uint32_t a_first, uint32_t a_count,
+                           double *a_ms) const
+    {
+        std::fill(a_ms, a_ms + a_count, 0.0);
+        if (timestampPool == VK_NULL_HANDLE) {
+            return;
+        }
+        std::vector<uint64_t> ticks(a_count + 1);
+        VK_CHECK_RESULT(vkGetQueryPoolResults(
+            device, timestampPool, a_first, a_count + 1,
+            ticks.size() * sizeof(uint64_t), ticks.data(), sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT));
+        const uint64_t mask =
+            timestampBits >= 64 ? ~uint64_t(0)
+                                : (uint64_t(1) << timestampBits) - 1;
+        for (uint32_t i = 0; i < a_count; ++i) {
+            a_ms[i] = double((ticks[i + 1] - ticks[i]) & mask) *
+                      timestampPeriod / 1e6;
+        }
+    }
+
+    static void writeTimestamp(VkCommandBuffer a_cmdBuff, VkQueryPool a_pool,
+                               VkPipelineStageFlagBits a_stage,
+                               uint32_t a_query)
+    {
+        if (a_pool != VK_NULL_HANDLE) {
+            vkCmdWriteTimestamp(a_cmdBuff, a_stage, a_pool, a_query);
+        }
+    }
+
+    void createDeviceBuffer(DeviceBuffer &a_buffer, size_t a_size,
+                            VkBufferUsageFlags a_usage,
+                            VkMemoryPropertyFlags a_properties)
+    {
+        createBuffer(device, physicalDevice, a_size, &a_buffer.buffer,
+                     &a_buffer.memory, a_usage, a_properties);
+        if (a_properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+            VK_CHECK_RESULT(vkMapMemory(device, a_buffer.memory, 0,
+                                        VK_WHOLE_SIZE, 0, &a_buffer.mapped));
+        }
+    }
+
+    void destroyDeviceBuffer(DeviceBuffer &a_buffer)
+    {
+        if (a_buffer.mapped) {
+            vkUnmapMemory(device, a_buffer.memory);
+        }
+        vkDestroyBuffer(device, a_buffer.buffer, NULL);
+        vkFreeMemory(device, a_buffer.memory, NULL);
+        a_buffer = DeviceBuffer();
+    }
+
+    void destroyFrameBuffers(FrameSlot &a_slot)
+    {
+        destroyDeviceBuffer(a_slot.upload);
+        destroyDeviceBuffer(a_slot.input);
+        destroyDeviceBuffer(a_slot.output);
+        destroyDeviceBuffer(a_slot.readback);
+        destroyDeviceBuffer(a_slot.rowBox);
+        destroyDeviceBuffer(a_slot.prefix);
+        destroyDeviceBuffer(a_slot.accum);
+        destroyDeviceBuffer(a_slot.source);
+        destroyDeviceBuffer(a_slot.packed);
+        a_slot.pixelCapacity = 0;
+        a_slot.prefixCapacity = 0;
+    }
+
+    // Makes the buffers of a_slot large enough for its tile region
+    // and points its descriptor set at them. The previous submission has
+    // completed by the time this runs, so the old buffers are free to go.
+    // On UMA devices the shader reads upload and output is mapped directly;
+    // the integral NLM scratch is 0 source, 1 result, 2 row patch sums,
+    // 3 prefix sums (shared by the row and the column pass), 4 weighted
+    // colour + weight accumulator. --gpu-convert adds the RGBA8 bindings
+    // 5 and 6 around them, see FrameSlot.
+    void reserveFrame(FrameSlot &a_slot)
+    {
+        const size_t width = a_slot.width;
+        const size_t height = a_slot.height;
+        const size_t pixelCount = width * height;
+        const size_t prefixCount =
+            integralNlm() ? std::max((width + 1) * height,
+                                     (height + 1) * width)
+                          : 0;
+        if (pixelCount <= a_slot.pixelCapacity &&
+            prefixCount <= a_slot.prefixCapacity) {
+            return;
+        }
+        destroyFrameBuffers(a_slot);
+
+        const size_t bufferSize = pixelBytes(params.format) * pixelCount;
+        const size_t transferSize = transferBytes() * pixelCount;
+        createDeviceBuffer(a_slot.upload, transferSize,
+                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                               VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                           hostMemory());
+        createDeviceBuffer(a_slot.output, bufferSize,
+                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                               VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                           workingMemory());
+        if (!uma) {
+            createDeviceBuffer(a_slot.input, transferSize,
+                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            createDeviceBuffer(a_slot.readback, transferSize,
+                               VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                               hostMemory() |
+                                   VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+        }
+
+        const VkBuffer uploaded =
+            uma ? a_slot.upload.buffer : a_slot.input.buffer;
+        std::vector<VkBuffer> buffers = {uploaded, a_slot.output.buffer};
+        if (integralNlm()) {
+            createDeviceBuffer(a_slot.rowBox, sizeof(float) * pixelCount,
+                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                               workingMemory());
+            createDeviceBuffer(a_slot.prefix, sizeof(float) * prefixCount,
+                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                               workingMemory());
+            createDeviceBuffer(a_slot.accum, sizeof(Pixel) * pixelCount,
+                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                               workingMemory());
+            buffers.push_back(a_slot.rowBox.buffer);
+            buffers.push_back(a_slot.prefix.buffer);
+            buffers.push_back(a_slot.accum.buffer);
+        }
+        if (params.gpuConvert) {
+            createDeviceBuffer(a_slot.source, bufferSize,
+                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                               workingMemory());
+            if (packResult()) {
+                createDeviceBuffer(a_slot.packed, 4 * pixelCount,
+                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                       VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                   workingMemory());
+            }
+            buffers.resize(7, VK_NULL_HANDLE);
+            buffers[0] = a_slot.source.buffer;
+            buffers[5] = uploaded;
+            buffers[6] = a_slot.packed.buffer;
+        }
+        updateDescriptorSetBuffers(device, a_slot.descriptorSet, buffers);
+        a_slot.pixelCapacity = pixelCount;
+        a_slot.prefixCapacity = prefixCount;
+    }
+
+    // The buffer holding the slot's filtered tile in resultFormat().
+    const DeviceBuffer &result(const FrameSlot &a_slot) const
+    {
+        return packResult() ? a_slot.packed : a_slot.output;
+    }
+
+    // Copies of the slot's tile region around the dispatch, none on UMA
+    // devices.
+    StagingCopies stagingCopies(const FrameSlot &a_slot) const
+    {
+        StagingCopies copies = {};
+        copies.computeFamily = VK_QUEUE_FAMILY_IGNORED;
+        copies.transferFamily = VK_QUEUE_FAMILY_IGNORED;
+        if (!uma) {
+            copies.upload = a_slot.hostSource.buffer != VK_NULL_HANDLE
+                                ? a_slot.hostSource.buffer
+                                : a_slot.upload.buffer;
+            copies.input = a_slot.input.buffer;
+            copies.output = result(a_slot).buffer;
+            copies.readback = a_slot.hostResult.buffer != VK_NULL_HANDLE
+                                  ? a_slot.hostResult.buffer
+                                  : a_slot.readback.buffer;
+            copies.size = transferBytes() * a_slot.width * a_slot.height;
+        }
+        if (!uma && transferQueue != VK_NULL_HANDLE) {
+            copies.computeFamily = queueFamilyIndex;
+            copies.transferFamily = transferFamilyIndex;
+        }
+        return copies;
+    }
+
+    // Single image through the sampled-image shaders. Host phases are timed
+    // with steady_clock; queries 0..1 of the timestamp pool enclose the
+    // upload into the image, then queries 0..2 the dispatch and the copy to
+    // the staging buffer.
+    void runImage()
+    {
+        FrameTimes times;
+        auto start = std::chrono::steady_clock::now();
+        readFile(params.input);
+        if (!pixels) {
+            throw std::runtime_error("failed to load " + params.input);
+        }
+        size_t bufferSize =
+            pixelBytes(params.format) * imageWidth * imageHeight;
+
+        if (params.verbose) {
+            std::cout << "creating resources ... " << std::endl;
+        }
+
+        createImage(
+            imageWidth, imageHeight, VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            image, imageMemory);
+
+        createBuffer(device, physicalDevice, bufferSize, &bufferStaging,
+                     &bufferMemoryStaging,
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                         VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                     hostMemory() | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+        createBuffer(device, physicalDevice, bufferSize, &bufferGPU,
+                     &bufferMemoryGPU,
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                     workingMemory());
+        createBuffer(device, physicalDevice, bufferSize, &bufferDynamic,
+                     &bufferMemoryDynamic,
+                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT, hostMemory());
+        readFileToMemory(device, bufferMemoryDynamic);
+
+        createImageView(image, imageView);
+        createTextureSampler(sampler);
+
+        createDescriptorSetLayout(
+            device, &descriptorSetLayout, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);  // here we will
+                                                         // create a binding
+                                                         // of buffer to
+                                                         // shader via
+                                                         // descriptorSet
+        createDescriptorSetForImages(
+            device, image, bufferGPU, imageView, sampler, bufferSize,
+            &descriptorSetLayout,  // (device, buffer, bufferSize,
+                                   // descriptorSetLayout) ==>
+            &descriptorPool,
+            &descriptorSet);  // (descriptorPool, descriptorSet)
+
+        if (params.verbose) {
+            std::cout << "compiling shaders  ... " << std::endl;
+        }
+
+        createPipelineLayout(device, descriptorSetLayout, &pipelineLayout);
+        pipeline = getPipeline(shaderPath(params), specConstants(params));
+
+        createCommandBuffer(device, queueFamilyIndex, &commandPool,
+                            &commandBuffer);
+        createTimestampPool(3);
+        vkResetCommandBuffer(commandBuffer, 0);
+        RecordCommandsOfCopyImageDataToTexture(
+            commandBuffer, pipeline, imageWidth, imageHeight,
+            bufferDynamic,  // bufferDynamic ==> imageGPU
+            &image, bufferStaging, timestampPool);
+        times.load = elapsedMs(start);
+
+        start = std::chrono::steady_clock::now();
+        runCommandBuffer(commandBuffer, queue, device);
+        times.wait = elapsedMs(start);
+        timestampDeltasMs(0, 1, &times.gpuUpload);
+
+        if (params.verbose) {
+            std::cout << "doing computations ... " << std::endl;
+        }
+        RecordCommandsOfExecuteAndTransfer(
+            commandBuffer, pipeline, pipelineLayout, descriptorSet, image,
+            bufferSize, bufferGPU, bufferStaging,
+            pushConstants(imageWidth, imageHeight),
+            params.workgroupSize, timestampPool);
+        start = std::chrono::steady_clock::now();
+        runCommandBuffer(commandBuffer, queue, device);
+        times.wait += elapsedMs(start);
+        double phases[2];
+        timestampDeltasMs(0, 2, phases);
+        times.gpuDispatch = phases[0];
+        times.gpuReadback = phases[1];
+        times.gpu = times.gpuUpload + times.gpuDispatch + times.gpuReadback;
+
+        if (params.verbose) {
+            std::cout << "saving image       ... " << std::endl;
+        }
+        std::vector<unsigned char> result(4 * size_t(imageWidth) *
+                                          imageHeight);
+        start = std::chrono::steady_clock::now();
+        readbackFromDeviceMemory(device, bufferMemoryStaging, imageWidth,
+                                 imageHeight, params.format, params.threads,
+                                 &result[0]);
+        times.readback = elapsedMs(start);
+        start = std::chrono::steady_clock::now();
+        writeImage(params.output, imageWidth, imageHeight, &result[0]);
+        times.save = elapsedMs(start);
+
+        if (params.verbose) {
+            std::cout << "destroying all     ... " << std::endl;
+            std::cout << "host: load " << times.load << " ms, wait "
+                      << times.wait << " ms, readback " << times.readback
+                      << " ms, save " << times.save << " ms" << std::endl;
+        }
+        if (timestampPool != VK_NULL_HANDLE && params.verbose) {
+            std::cout << "gpu: upload " << times.gpuUpload << " ms, dispatch "
+                      << times.gpuDispatch << " ms, readback "
+                      << times.gpuReadback << " ms" << std::endl;
+        }
+        if (!params.profile.empty()) {
+            appendProfile(params.profile, params.input, imageWidth,
+                          imageHeight, times);
+        }
+        cleanupImage();
+    }
+
+public:
+    // Converts the a_width x a_height image in a_bufferMemory to RGBA8 in
+    // a_image, mapping the memory once and splitting the rows across
+    // a_threads.
+    static void readbackFromDeviceMemory(VkDevice a_device,
+                                         VkDeviceMemory a_bufferMemory,
+                                         int a_width, int a_height,
+                                         pixelFormat a_format, int a_threads,
+                                         unsigned char *a_image)
+    {
+        const size_t rowBytes = pixelBytes(a_format) * a_width;
+        void *mappedMemory = nullptr;
+        VK_CHECK_RESULT(vkMapMemory(a_device, a_bufferMemory, 0,
+                                    rowBytes * a_height, 0, &mappedMemory));
+        unpackRowsToRgba8(mappedMemory, rowBytes, a_width, a_height, a_format,
+                          a_image, 4 * size_t(a_width), a_threads);
+        vkUnmapMemory(a_device, a_bufferMemory);
+    }
+
+    static VKAPI_ATTR VkBool32 VKAPI_CALL debugReportCallbackFn(
+        VkDebugReportFlagsEXT flags, VkDebugReportObjectTypeEXT objectType,
+        uint64_t object, size_t location, int32_t messageCode,
+        const char *pLayerPrefix, const char *pMessage, void *pUserData)
+    {
+        fprintf(stderr, "Debug Report: %s: %s\n", pLayerPrefix, pMessage);
+        return VK_FALSE;
+    }
+
+    // HOST_CACHED in a_properties is a preference: it is dropped when no
+    // memory type offers it together with the other flags.
+    static void createBuffer(VkDevice a_device, VkPhysicalDevice a_physDevice,
+                             const size_t a_bufferSize, VkBuffer *a_pBuffer,
+                             VkDeviceMemory *a_pBufferMemory,
+                             VkBufferUsageFlags usage,
+                             VkMemoryPropertyFlags a_properties)
+    {
+        VkBufferCreateInfo bufferCreateInfo = {};
+        bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferCreateInfo.size = a_bufferSize;  // buffer size in bytes.
+        bufferCreateInfo.usage = usage;        // buffer is used as a storage
+                                               // buffer.
+        bufferCreateInfo.sharingMode =
+            VK_SHARING_MODE_EXCLUSIVE;  // buffer is exclusive to a single queue
+                                        // family at a time.
+
+        VK_CHECK_RESULT(vkCreateBuffer(a_device, &bufferCreateInfo, NULL,
+                                       a_pBuffer));  // create buffer.
+
+        VkMemoryRequirements memoryRequirements;
+        vkGetBufferMemoryRequirements(a_device, (*a_pBuffer),
+                                      &memoryRequirements);
+
+        VkMemoryAllocateInfo allocateInfo = {};
+        allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocateInfo.allocationSize =
+            memoryRequirements.size;  // specify required memory.
+        allocateInfo.memoryTypeIndex = vk_utils::FindMemoryType(
+            memoryRequirements.memoryTypeBits, a_properties, a_physDevice);
+        if (allocateInfo.memoryTypeIndex == uint32_t(-1) &&
+            (a_properties & VK_MEMORY_PROPERTY_HOST_CACHED_BIT)) {
+            allocateInfo.memoryTypeIndex = vk_utils::FindMemoryType(
+                memoryRequirements.memoryTypeBits,
+                a_properties & ~VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                a_physDevice);
+        }
+        if (allocateInfo.memoryTypeIndex == uint32_t(-1)) {
+            throw std::runtime_error("no memory type for buffer");
+        }
+        VK_CHECK_RESULT(
+            vkAllocateMemory(a_device, &allocateInfo, NULL,
+                             a_pBufferMemory));  // allocate memory on device.
+
+        VK_CHECK_RESULT(
+            vkBindBufferMemory(a_device, (*a_pBuffer), (*a_pBufferMemory), 0));
+    }
+
+    void createImage(uint32_t width, uint32_t height, VkImageTiling tiling,
+                     VkImageLayout layout, VkImageUsageFlags usage,
+                     VkImage &image, VkDeviceMemory &imageMemory)
+    {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = width;
+        imageInfo.extent.height = height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = imageFormat(params.format);
+        imageInfo.tiling = tiling;
+        imageInfo.initialLayout = layout;
+        imageInfo.usage = usage;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VK_CHECK_RESULT(vkCreateImage(device, &imageInfo, nullptr, &image));
+
+        VkMemoryRequirements memoryRequirements;
+        vkGetImageMemoryRequirements(device, image, &memoryRequirements);
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memoryRequirements.size;
+        allocInfo.memoryTypeIndex =
+            vk_utils::FindMemoryType(memoryRequirements.memoryTypeBits,
+                                     workingMemory(), physicalDevice);
+
+        if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) !=
+            VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate image memory!");
+        }
+
+        vkBindImageMemory(device, image, imageMemory, 0);
+    }
+
+    void readFileToMemory(VkDevice &device, VkDeviceMemory &bufMemory)
+    {
+        VkDeviceSize bufSize =
+            pixelBytes(params.format) * imageWidth * imageHeight;
+        if (!pixels) {
+            throw std::runtime_error("failed to load texture image!");
+        }
+
+        void *data;
+        vkMapMemory(device, bufMemory, 0, bufSize, 0, &data);
+        packPixels(pixels, size_t(imageWidth) * imageHeight, params.format,
+                   data);
+        vkUnmapMemory(device, bufMemory);
+        stbi_image_free(pixels);
+    }
+
+    // Decodes into pixels, or into packedPixels as 8-bit RGBA without the
+    // float expansion with --gpu-convert.
+    void readFile(const std::string &a_fileName)
+    {
+        int width = 0, height = 0, texChannels;
+        if (params.gpuConvert) {
+            packedPixels = stbi_load(a_fileName.c_str(), &width, &height,
+                                     &texChannels, STBI_rgb_alpha);
+        }
+        else {
+            pixels = stbi_loadf(a_fileName.c_str(), &width, &height,
+                                &texChannels, STBI_rgb_alpha);
+        }
+        imageWidth = unsigned(width);
+        imageHeight = unsigned(height);
+    }
+
+    static void copyImageToImage(VkCommandBuffer &commandBuffer,
+                                 VkImage &srcImage, VkImage &dstImage,
+                                 uint32_t a_width, uint32_t a_height)
+    {
+        VkImageSubresourceLayers imgSub;
+        imgSub.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        imgSub.baseArrayLayer = 0;
+        imgSub.layerCount = 1;
+        imgSub.mipLevel = 0;
+        VkImageSubresourceLayers imgSub2;
+        imgSub2.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        imgSub2.baseArrayLayer = 0;
+        imgSub2.layerCount = 1;
+        imgSub2.mipLevel = 0;
+
+        VkOffset3D offset;
+        offset.x = 0;
+        offset.y = 0;
+        offset.z = 0;
+
+        VkExtent3D extent;
+        extent.depth = 1;
+        extent.width = a_width;
+        extent.height = a_height;
+
+        VkImageCopy imgCopy;
+        imgCopy.srcSubresource = imgSub;
+        imgCopy.srcOffset = offset;
+        imgCopy.dstSubresource = imgSub2;
+        imgCopy.dstOffset = offset;
+        imgCopy.extent = extent;
+        vkCmdCopyImage(commandBuffer, srcImage,
+                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dstImage,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imgCopy);
+    }
+    static void copyImageToBuffer(VkCommandBuffer &commandBuffer,
+                                  VkImage &srcImage, VkBuffer &dstBuffer,
+                                  uint32_t a_width, uint32_t a_height)
+    {
+        VkImageSubresourceLayers imgSub;
+        imgSub.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        imgSub.baseArrayLayer = 0;
+        imgSub.layerCount = 1;
+        imgSub.mipLevel = 0;
+
+        VkOffset3D offset;
+        offset.x = 0;
+        offset.y = 0;
+        offset.z = 0;
+
+        VkExtent3D extent;
+        extent.depth = 1;
+        extent.width = a_width;
+        extent.height = a_height;
+
+        VkBufferImageCopy imgBufInfo;
+        imgBufInfo.imageOffset = offset;
+        imgBufInfo.bufferOffset = 0;
+        imgBufInfo.imageExtent = extent;
+        imgBufInfo.bufferRowLength = a_width;
+        imgBufInfo.bufferImageHeight = a_height;
+        imgBufInfo.imageSubresource = imgSub;
+
+        vkCmdCopyImageToBuffer(commandBuffer, srcImage,
+                               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dstBuffer,
+                               1, &imgBufInfo);
+    }
+
+    void createImageView(VkImage &image, VkImageView &imView)
+    {
+        VkImageViewCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        createInfo.image = image;
+        createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        createInfo.format = imageFormat(params.format);
+        createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+        createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+        createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+        createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+        createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        createInfo.subresourceRange.baseMipLevel = 0;
+        createInfo.subresourceRange.levelCount = 1;
+        createInfo.subresourceRange.baseArrayLayer = 0;
+        createInfo.subresourceRange.layerCount = 1;
+        VK_CHECK_RESULT(
+            vkCreateImageView(device, &createInfo, nullptr, &imView));
+    }
+
+    void createTextureSampler(VkSampler &sampler)
+    {
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.pNext = nullptr;
+        samplerInfo.flags = 0;
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.mipLodBias = 0.0f;
+        samplerInfo.compareOp = VK_COMPARE_OP_NEVER;
+        samplerInfo.minLod = 0;
+        samplerInfo.maxLod = 0;
+        samplerInfo.maxAnisotropy = 1.0;
+        samplerInfo.anisotropyEnable = VK_FALSE;
+        samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+        samplerInfo.unnormalizedCoordinates = VK_TRUE;
+
+        if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) !=
+            VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture sampler!");
+        }
+    }
+
+    static void createDescriptorSetLayout(VkDevice a_device,
+                                          VkDescriptorSetLayout *a_pDSLayout,
+                                          VkDescriptorType descriptorType1,
+                                          VkDescriptorType descriptorType2)
+    {
+        VkDescriptorSetLayoutBinding descriptorSetLayoutBinding = {};
+        descriptorSetLayoutBinding.binding = 0;  // binding = 0
+        descriptorSetLayoutBinding.descriptorType = descriptorType1;
+        descriptorSetLayoutBinding.descriptorCount = 1;
+        descriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+        VkDescriptorSetLayoutBinding descriptorSetLayoutBinding2 = {};
+        descriptorSetLayoutBinding2.binding = 1;  // binding = 0
+        descriptorSetLayoutBinding2.descriptorType = descriptorType2;
+        descriptorSetLayoutBinding2.descriptorCount = 1;
+        descriptorSetLayoutBinding2.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+        VkDescriptorSetLayoutBinding pointer[2] = {descriptorSetLayoutBinding,
+                                                   descriptorSetLayoutBinding2};
+
+        VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {};
+        descriptorSetLayoutCreateInfo.sType =
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        descriptorSetLayoutCreateInfo.bindingCount =
+            2;  // only a single binding in this descriptor set layout.
+        descriptorSetLayoutCreateInfo.pBindings = pointer;
+
+        VK_CHECK_RESULT(vkCreateDescriptorSetLayout(
+            a_device, &descriptorSetLayoutCreateInfo, NULL, a_pDSLayout));
+    }
+
+    void createDescriptorSetForImages(VkDevice a_device, VkImage &imageSrc,
+                                      VkBuffer &buffer, VkImageView &iViewSrc,
+                                      VkSampler &sampler, size_t a_imageSize,
+                                      const VkDescriptorSetLayout *a_pDSLayout,
+                                      VkDescriptorPool *a_pDSPool,
+                                      VkDescriptorSet *a_pDS)
+    {
+        VkDescriptorPoolSize descriptorPoolSize = {};
+        descriptorPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorPoolSize.descriptorCount = 1;
+
+        VkDescriptorPoolSize descriptorPoolSize2 = {};
+        descriptorPoolSize2.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorPoolSize2.descriptorCount = 1;
+
+        VkDescriptorPoolSize pool[2] = {descriptorPoolSize,
+                                        descriptorPoolSize2};
+
+        VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {};
+        descriptorPoolCreateInfo.sType =
+            VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        descriptorPoolCreateInfo.maxSets =
+            2;  // we only need to allocate one descriptor set from the pool.
+        descriptorPoolCreateInfo.poolSizeCount = 2;
+        descriptorPoolCreateInfo.pPoolSizes = pool;
+
+        VK_CHECK_RESULT(vkCreateDescriptorPool(
+            a_device, &descriptorPoolCreateInfo, NULL, a_pDSPool));
+
+        VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {};
+        descriptorSetAllocateInfo.sType =
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        descriptorSetAllocateInfo.descriptorPool =
+            (*a_pDSPool);  // pool to allocate from.
+        descriptorSetAllocateInfo.descriptorSetCount =
+            1;  // allocate a single descriptor set.
+        descriptorSetAllocateInfo.pSetLayouts = a_pDSLayout;
+
+        VK_CHECK_RESULT(vkAllocateDescriptorSets(
+            a_device, &descriptorSetAllocateInfo, a_pDS));
+
+        VkDescriptorImageInfo descriptorImageInfo;
+        descriptorImageInfo.imageLayout =
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        descriptorImageInfo.imageView = iViewSrc;
+        descriptorImageInfo.sampler = sampler;
+
+        VkDescriptorBufferInfo descriptorBufferInfo;
+        descriptorBufferInfo.buffer = buffer;
+        descriptorBufferInfo.range = VK_WHOLE_SIZE;
+        descriptorBufferInfo.offset = 0;
+
+        VkWriteDescriptorSet writeDescriptorSet = {};
+        writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSet.dstSet = (*a_pDS);  // write to this descriptor set.
+        writeDescriptorSet.dstBinding =
+            1;  // write to the first, and only binding.
+        writeDescriptorSet.descriptorCount = 1;  // update a single descriptor.
+        writeDescriptorSet.descriptorType =
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;  // storage buffer.
+        writeDescriptorSet.pImageInfo = &descriptorImageInfo;
+
+        VkWriteDescriptorSet writeDescriptorSet2 = {};
+        writeDescriptorSet2.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSet2.dstSet = (*a_pDS);  // write to this descriptor set.
+        writeDescriptorSet2.dstBinding =
+            0;  // write to the first, and only binding.
+        writeDescriptorSet2.descriptorCount = 1;  // update a single descriptor.
+        writeDescriptorSet2.descriptorType =
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;  // storage buffer.
+
+        writeDescriptorSet2.pBufferInfo = &descriptorBufferInfo;
+
+        VkWriteDescriptorSet p_Write[2] = {writeDescriptorSet,
+                                           writeDescriptorSet2};
+        vkUpdateDescriptorSets(a_device, 2, p_Write, 0, NULL);
+    }
+    // Layout of a_count storage buffers at bindings 0 .. a_count - 1.
+    static void createStorageDescriptorSetLayout(
+        VkDevice a_device, uint32_t a_count,
+        VkDescriptorSetLayout *a_pDSLayout)
+    {
+        std::vector<VkDescriptorSetLayoutBinding> bindings(a_count);
+        for (uint32_t i = 0; i < a_count; ++i) {
+            bindings[i] = {};
+            bindings[i].binding = i;
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+
+        VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {};
+        descriptorSetLayoutCreateInfo.sType =
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        descriptorSetLayoutCreateInfo.bindingCount = a_count;
+        descriptorSetLayoutCreateInfo.pBindings = bindings.data();
+
+        VK_CHECK_RESULT(vkCreateDescriptorSetLayout(
+            a_device, &descriptorSetLayoutCreateInfo, NULL, a_pDSLayout));
+    }
+
+    // Allocates a_setCount sets of a_count storage buffers each from a new
+    // pool.
+    static void allocateDescriptorSets(VkDevice a_device, uint32_t a_count,
+                                       uint32_t a_setCount,
+                                       VkDescriptorSetLayout a_dsLayout,
+                                       VkDescriptorPool *a_pDSPool,
+                                       VkDescriptorSet *a_pDS)
+    {
+        VkDescriptorPoolSize descriptorPoolSize = {};
+        descriptorPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorPoolSize.descriptorCount = a_count * a_setCount;
+
+        VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {};
+        descriptorPoolCreateInfo.sType =
+            VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        descriptorPoolCreateInfo.maxSets = a_setCount;
+        descriptorPoolCreateInfo.poolSizeCount = 1;
+        descriptorPoolCreateInfo.pPoolSizes = &descriptorPoolSize;
+
+        VK_CHECK_RESULT(vkCreateDescriptorPool(
+            a_device, &descriptorPoolCreateInfo, NULL, a_pDSPool));
+
+        std::vector<VkDescriptorSetLayout> layouts(a_setCount, a_dsLayout);
+        VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {};
+        descriptorSetAllocateInfo.sType =
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        descriptorSetAllocateInfo.descriptorPool = (*a_pDSPool);
+        descriptorSetAllocateInfo.descriptorSetCount = a_setCount;
+        descriptorSetAllocateInfo.pSetLayouts = layouts.data();
+
+        VK_CHECK_RESULT(vkAllocateDescriptorSets(
+            a_device, &descriptorSetAllocateInfo, a_pDS));
+    }
+
+    // Binds a_buffers[i] to binding i of a_ds. VK_NULL_HANDLE entries are
+    // skipped, no pipeline of the run reads them.
+    static void updateDescriptorSetBuffers(
+        VkDevice a_device, VkDescriptorSet a_ds,
+        const std::vector<VkBuffer> &a_buffers)
+    {
+        const uint32_t count = uint32_t(a_buffers.size());
+        std::vector<VkDescriptorBufferInfo> bufferInfos(count);
+        std::vector<VkWriteDescriptorSet> writes;
+        for (uint32_t i = 0; i < count; ++i) {
+            if (a_buffers[i] == VK_NULL_HANDLE) {
+                continue;
+            }
+            bufferInfos[i].buffer = a_buffers[i];
+            bufferInfos[i].offset = 0;
+            bufferInfos[i].range = VK_WHOLE_SIZE;
+
+            VkWriteDescriptorSet write = {};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = a_ds;
+            write.dstBinding = i;
+            write.descriptorCount = 1;
+            write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            write.pBufferInfo = &bufferInfos[i];
+            writes.push_back(write);
+        }
+        vkUpdateDescriptorSets(a_device, uint32_t(writes.size()),
+                               writes.data(), 0, NULL);
+    }
+
+    // Makes the shader writes of one dispatch visible to the next.
+    static void computeBarrier(VkCommandBuffer a_cmdBuff,
+                               VkAccessFlags a_srcAccess,
+                               VkPipelineStageFlags a_srcStage)
+    {
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = a_srcAccess;
+        barrier.dstAccessMask =
+            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(a_cmdBuff, a_srcStage,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                             &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    void integralPipelines(VkPipeline &a_rows, VkPipeline &a_cols,
+                           VkPipeline &a_norm)
+    {
+        const SpecConstants spec = specConstants(params);
+        a_rows = getPipeline("shaders/nlm_integral_rows.spv", spec);
+        a_cols = getPipeline("shaders/nlm_integral_cols.spv", spec);
+        a_norm = getPipeline("shaders/nlm_integral_norm.spv", spec);
+    }
+
+    // Row and column pass for every offset of the search window, then the
+    // normalisation, recorded into a command buffer that is already begun.
+    // The 1D passes run one invocation per row or column, a whole workgroup
+    // of them per group.
+    void recordIntegralNlmTo(VkCommandBuffer a_cmdBuff,
+                             const FrameSlot &a_slot)
+    {
+        VkPipeline rowsPipeline, colsPipeline, normPipeline;
+        integralPipelines(rowsPipeline, colsPipeline, normPipeline);
+        const float groupSize =
+            float(params.workgroupSize * params.workgroupSize);
+        const int radius = params.nlmParams.radius;
+
+        vkCmdBindDescriptorSets(a_cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                pipelineLayout, 0, 1, &a_slot.descriptorSet, 0,
+                                NULL);
+        vkCmdFillBuffer(a_cmdBuff, a_slot.accum.buffer, 0, VK_WHOLE_SIZE, 0);
+        computeBarrier(a_cmdBuff, VK_ACCESS_TRANSFER_WRITE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        PushConstants pc = pushConstants(a_slot.width, a_slot.height);
+        for (pc.dy = -radius; pc.dy <= radius; ++pc.dy) {
+            for (pc.dx = -radius; pc.dx <= radius; ++pc.dx) {
+                vkCmdPushConstants(a_cmdBuff, pipelineLayout,
+                                   VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                   sizeof(PushConstants), &pc);
+                vkCmdBindPipeline(a_cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                  rowsPipeline);
+                vkCmdDispatch(a_cmdBuff,
+                              (uint32_t)ceil(a_slot.height / groupSize), 1, 1);
+                computeBarrier(a_cmdBuff, VK_ACCESS_SHADER_WRITE_BIT,
+                               VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+                vkCmdBindPipeline(a_cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                  colsPipeline);
+                vkCmdDispatch(a_cmdBuff,
+                              (uint32_t)ceil(a_slot.width / groupSize), 1, 1);
+                computeBarrier(a_cmdBuff, VK_ACCESS_SHADER_WRITE_BIT,
+                               VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            }
+        }
+
+        vkCmdBindPipeline(a_cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          normPipeline);
+        vkCmdDispatch(a_cmdBuff,
+                      (uint32_t)ceil(a_slot.width / float(params.workgroupSize)),
+                      (uint32_t)ceil(a_slot.height / float(params.workgroupSize)),
+                      1);
+    }
+
+    static void createPipelineLayout(VkDevice a_device,
+                                     const VkDescriptorSetLayout &a_dsLayout,
+                                     VkPipelineLayout *a_pPipelineLayout)
+    {
+        VkPushConstantRange pcRange =
+            {};  // #NOTE: we updated this to pass W/H inside shader
+        pcRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pcRange.offset = 0;
+        pcRange.size = sizeof(PushConstants);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+        pipelineLayoutCreateInfo.sType =
+            VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutCreateInfo.setLayoutCount = 1;
+        pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+        pipelineLayoutCreateInfo.pPushConstantRanges = &pcRange;
+        pipelineLayoutCreateInfo.pSetLayouts = &a_dsLayout;
+        VK_CHECK_RESULT(vkCreatePipelineLayout(
+            a_device, &pipelineLayoutCreateInfo, NULL, a_pPipelineLayout));
+    }
+
+    static void createComputePipeline(VkDevice a_device,
+                                      VkShaderModule a_shaderModule,
+                                      VkPipelineLayout a_pipelineLayout,
+                                      const SpecConstants &a_spec,
+                                      VkPipelineCache a_cache,
+                                      VkPipeline *a_pPipeline)
+    {
+        // constant_id -> field of SpecConstants, see the .comp files
+        const VkSpecializationMapEntry specEntries[9] = {
+            {0, offsetof(SpecConstants, workgroupSize), sizeof(int)},
+            {1, offsetof(SpecConstants, workgroupSize), sizeof(int)},
+            {2, offsetof(SpecConstants, radius), sizeof(int)},
+            {3, offsetof(SpecConstants, patch), sizeof(int)},
+            {4, offsetof(SpecConstants, sigma1), sizeof(float)},
+            {5, offsetof(SpecConstants, sigma2), sizeof(float)},
+            {6, offsetof(SpecConstants, workgroupSize), sizeof(int)},
+            {7, offsetof(SpecConstants, format), sizeof(int)},
+            {8, offsetof(SpecConstants, linearize), sizeof(VkBool32)}};
+
+        VkSpecializationInfo specInfo = {};
+        specInfo.mapEntryCount = 9;
+        specInfo.pMapEntries = specEntries;
+        specInfo.dataSize = sizeof(SpecConstants);
+        specInfo.pData = &a_spec;
+
+        VkPipelineShaderStageCreateInfo shaderStageCreateInfo = {};
+        shaderStageCreateInfo.sType =
+            VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStageCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        shaderStageCreateInfo.module = a_shaderModule;
+        shaderStageCreateInfo.pName = "main";
+        shaderStageCreateInfo.pSpecializationInfo = &specInfo;
+
+        VkComputePipelineCreateInfo pipelineCreateInfo = {};
+        pipelineCreateInfo.sType =
+            VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineCreateInfo.stage = shaderStageCreateInfo;
+        pipelineCreateInfo.layout = a_pipelineLayout;
+
+        VK_CHECK_RESULT(vkCreateComputePipelines(a_device, a_cache, 1,
+                                                 &pipelineCreateInfo, NULL,
+                                                 a_pPipeline));
+    }
+
+    static void createCommandPool(VkDevice a_device,
+                                  uint32_t queueFamilyIndex,
+                                  VkCommandPool *a_pool)
+    {
+        VkCommandPoolCreateInfo commandPoolCreateInfo = {};
+        commandPoolCreateInfo.sType =
+            VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        commandPoolCreateInfo.flags =
+            VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+        commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+        VK_CHECK_RESULT(vkCreateCommandPool(a_device, &commandPoolCreateInfo,
+                                            NULL, a_pool));
+    }
+
+    static void allocateCommandBuffers(VkDevice a_device, VkCommandPool a_pool,
+                                       uint32_t a_count,
+                                       VkCommandBuffer *a_pCmdBuffs)
+    {
+        VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+        commandBufferAllocateInfo.sType =
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandBufferAllocateInfo.commandPool =
+            a_pool;  // specify the command pool to allocate from.
+
+        commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        commandBufferAllocateInfo.commandBufferCount = a_count;
+        VK_CHECK_RESULT(vkAllocateCommandBuffers(
+            a_device, &commandBufferAllocateInfo, a_pCmdBuffs));
+    }
+
+    static void createCommandBuffer(VkDevice a_device,
+                                    uint32_t queueFamilyIndex,
+                                    VkCommandPool *a_pool,
+                                    VkCommandBuffer *a_pCmdBuff)
+    {
+        createCommandPool(a_device, queueFamilyIndex, a_pool);
+        allocateCommandBuffers(a_device, *a_pool, 1, a_pCmdBuff);
+    }
+
+    // Dispatch of a single-pass shader over a_pc.width x a_pc.height,
+    // recorded into a command buffer that is already begun.
+    static void recordCommandsTo(VkCommandBuffer a_cmdBuff,
+                                 VkPipeline a_pipeline,
+                                 VkPipelineLayout a_layout,
+                                 const VkDescriptorSet &a_ds,
+                                 const PushConstants &a_pc,
+                                 int a_workgroupSize)
+    {
+        vkCmdBindPipeline(a_cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          a_pipeline);
+        vkCmdBindDescriptorSets(a_cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                a_layout, 0, 1, &a_ds, 0, NULL);
+        vkCmdPushConstants(a_cmdBuff, a_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                           sizeof(PushConstants), &a_pc);
+        vkCmdDispatch(a_cmdBuff,
+                      (uint32_t)ceil(a_pc.width / float(a_workgroupSize)),
+                      (uint32_t)ceil(a_pc.height / float(a_workgroupSize)), 1);
+    }
+
+    static bool separateTransferQueue(const StagingCopies &a_staging)
+    {
+        return a_staging.transferFamily != a_staging.computeFamily;
+    }
+
+    // Barrier on a whole buffer. With different families it is the release
+    // or acquire half of an ownership transfer, depending on the queue the
+    // command buffer goes to.
+    static void bufferBarrier(VkCommandBuffer a_cmdBuff, VkBuffer a_buffer,
+                              VkAccessFlags a_srcAccess,
+                              VkAccessFlags a_dstAccess,
+                              uint32_t a_srcFamily, uint32_t a_dstFamily,
+                              VkPipelineStageFlags a_srcStage,
+                              VkPipelineStageFlags a_dstStage)
+    {
+        VkBufferMemoryBarrier bufBarr = {};
+        bufBarr.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        bufBarr.srcQueueFamilyIndex = a_srcFamily;
+        bufBarr.dstQueueFamilyIndex = a_dstFamily;
+        bufBarr.buffer = a_buffer;
+        bufBarr.offset = 0;
+        bufBarr.size = VK_WHOLE_SIZE;
+        bufBarr.srcAccessMask = a_srcAccess;
+        bufBarr.dstAccessMask = a_dstAccess;
+        vkCmdPipelineBarrier(a_cmdBuff, a_srcStage, a_dstStage, 0, 0, nullptr,
+                             1, &bufBarr, 0, nullptr);
+    }
+
+    // Host-visible upload buffer -> device-local input, visible to the
+    // compute shader. Nothing to do on UMA devices. With a transfer queue
+    // the copy was submitted there and only the acquire of input is left.
+    static void recordUpload(VkCommandBuffer a_cmdBuff,
+                             const StagingCopies &a_staging)
+    {
+        if (a_staging.upload == VK_NULL_HANDLE) {
+            return;
+        }
+        if (!separateTransferQueue(a_staging)) {
+            recordUploadCopy(a_cmdBuff, a_staging);
+            return;
+        }
+        bufferBarrier(a_cmdBuff, a_staging.input, 0,
+                      VK_ACCESS_SHADER_READ_BIT, a_staging.transferFamily,
+                      a_staging.computeFamily,
+                      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    }
+
+    // The copy of recordUpload, releasing input to the compute queue when
+    // it runs on the transfer queue, which has no compute stage to wait in.
+    static void recordUploadCopy(VkCommandBuffer a_cmdBuff,
+                                 const StagingCopies &a_staging)
+    {
+        VkBufferCopy copyInfo = {};
+        copyInfo.size = a_staging.size;
+        vkCmdCopyBuffer(a_cmdBuff, a_staging.upload, a_staging.input, 1,
+                        &copyInfo);
+        bufferBarrier(a_cmdBuff, a_staging.input, VK_ACCESS_TRANSFER_WRITE_BIT,
+                      VK_ACCESS_SHADER_READ_BIT, a_staging.transferFamily,
+                      a_staging.computeFamily, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                      separateTransferQueue(a_staging)
+                          ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT
+                          : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    }
+
+    // Device-local result -> host-visible readback buffer, made visible to
+    // the host once the fence signals. With a transfer queue this only
+    // releases output to it; recordReadbackCopy runs there.
+    static void recordReadback(VkCommandBuffer a_cmdBuff,
+                               const StagingCopies &a_staging)
+    {
+        if (a_staging.output == VK_NULL_HANDLE) {
+            return;
+        }
+        bufferBarrier(a_cmdBuff, a_staging.output, VK_ACCESS_SHADER_WRITE_BIT,
+                      VK_ACCESS_TRANSFER_READ_BIT, a_staging.computeFamily,
+                      a_staging.transferFamily,
+                      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                      VK_PIPELINE_STAGE_TRANSFER_BIT);
+        if (!separateTransferQueue(a_staging)) {
+            recordReadbackCopy(a_cmdBuff, a_staging);
+        }
+    }
+
+    static void recordReadbackCopy(VkCommandBuffer a_cmdBuff,
+                                   const StagingCopies &a_staging)
+    {
+        if (separateTransferQueue(a_staging)) {
+            bufferBarrier(a_cmdBuff, a_staging.output, 0,
+                          VK_ACCESS_TRANSFER_READ_BIT, a_staging.computeFamily,
+                          a_staging.transferFamily,
+                          VK_PIPELINE_STAGE_TRANSFER_BIT,
+                          VK_PIPELINE_STAGE_TRANSFER_BIT);
+        }
+        VkBufferCopy copyInfo = {};
+        copyInfo.size = a_staging.size;
+        vkCmdCopyBuffer(a_cmdBuff, a_staging.output, a_staging.readback, 1,
+                        &copyInfo);
+
+        VkMemoryBarrier hostBarrier = {};
+        hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(a_cmdBuff, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0,
+                             nullptr, 0, nullptr);
+    }
+
+    static VkImageMemoryBarrier imBarTransfer(
+        VkImage a_image, const VkImageSubresourceRange &a_range,
+        VkImageLayout before, VkImageLayout after) 
+    {
+        VkImageMemoryBarrier moveToGeneralBar = {};
+        moveToGeneralBar.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        moveToGeneralBar.pNext = nullptr;
+        moveToGeneralBar.srcAccessMask = 0;
+        moveToGeneralBar.dstAccessMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        moveToGeneralBar.oldLayout = before;
+        moveToGeneralBar.newLayout = after;
+        moveToGeneralBar.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        moveToGeneralBar.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        moveToGeneralBar.image = a_image;
+        moveToGeneralBar.subresourceRange = a_range;
+        return moveToGeneralBar;
+    }
+
+    static VkImageSubresourceRange WholeImageRange()
+    {
+        VkImageSubresourceRange rangeWholeImage = {};
+        rangeWholeImage.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        rangeWholeImage.baseMipLevel = 0;
+        rangeWholeImage.levelCount = 1;
+        rangeWholeImage.baseArrayLayer = 0;
+        rangeWholeImage.layerCount = 1;
+        return rangeWholeImage;
+    }
+
+    static void RecordCommandsOfExecuteAndTransfer(
+        VkCommandBuffer a_cmdBuff, VkPipeline a_pipeline,
+        VkPipelineLayout a_layout, const VkDescriptorSet &a_ds, VkImage a_image,
+        size_t a_bufferSize, VkBuffer a_bufferGPU, VkBuffer a_bufferStaging,
+        const PushConstants &a_pc, int a_workgroupSize,
+        VkQueryPool a_timestamps)
+    {
+      
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags =
+            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT; 
+        VK_CHECK_RESULT(vkBeginCommandBuffer(
+            a_cmdBuff, &beginInfo)); 
+        if (a_timestamps != VK_NULL_HANDLE) {
+            vkCmdResetQueryPool(a_cmdBuff, a_timestamps, 0, 3);
+        }
+        writeTimestamp(a_cmdBuff, a_timestamps,
+                       VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0);
+
+        vkCmdFillBuffer(
+            a_cmdBuff, a_bufferStaging, 0, a_bufferSize,
+            0); 
+
+     
+        vkCmdBindPipeline(a_cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          a_pipeline);
+        vkCmdBindDescriptorSets(a_cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                a_layout, 0, 1, &a_ds, 0, NULL);
+
+        vkCmdPushConstants(a_cmdBuff, a_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                           sizeof(PushConstants), &a_pc);
+    
+        vkCmdDispatch(a_cmdBuff,
+                      (uint32_t)ceil(a_pc.width / float(a_workgroupSize)),
+                      (uint32_t)ceil(a_pc.height / float(a_workgroupSize)), 1);
+        writeTimestamp(a_cmdBuff, a_timestamps,
+                       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 1);
+
+        VkBufferMemoryBarrier bufBarr = {};
+        bufBarr.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        bufBarr.pNext = nullptr;
+        bufBarr.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufBarr.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufBarr.size = VK_WHOLE_SIZE;
+        bufBarr.offset = 0;
+        bufBarr.buffer = a_bufferGPU;
+        bufBarr.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        bufBarr.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        vkCmdPipelineBarrier(a_cmdBuff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1,
+                             &bufBarr, 0, nullptr);
+
+        VkBufferCopy copyInfo = {};
+        copyInfo.dstOffset = 0;
+        copyInfo.srcOffset = 0;
+        copyInfo.size = a_bufferSize;
+
+        vkCmdCopyBuffer(a_cmdBuff, a_bufferGPU, a_bufferStaging, 1, &copyInfo);
+        writeTimestamp(a_cmdBuff, a_timestamps,
+                       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 2);
+
+        VK_CHECK_RESULT(
+            vkEndCommandBuffer(a_cmdBuff));  // end recording commands.
+    }
+
+    static void RecordCommandsOfCopyImageDataToTexture(
+        VkCommandBuffer a_cmdBuff, VkPipeline a_pipeline, int a_width,
+        int a_height, VkBuffer a_bufferDynamic, VkImage *a_images,
+        VkBuffer a_bufferStaging, VkQueryPool a_timestamps)
+    {
+        //// Now we shall start recording commands into the newly allocated
+        /// command bufferStaging.
+        //
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags =
+            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;  // the bufferStaging
+                                                          // is only submitted
+                                                          // and used once in
+                                                          // this application.
+        VK_CHECK_RESULT(vkBeginCommandBuffer(
+            a_cmdBuff, &beginInfo));  // start recording commands.
+        if (a_timestamps != VK_NULL_HANDLE) {
+            vkCmdResetQueryPool(a_cmdBuff, a_timestamps, 0, 3);
+        }
+        writeTimestamp(a_cmdBuff, a_timestamps,
+                       VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0);
+
+        vkCmdFillBuffer(
+            a_cmdBuff, a_bufferStaging, 0, VK_WHOLE_SIZE,
+            0);  // clear this buffer just for an example and test cases. if we
+                 // comment 'vkCmdCopyBuffer', we'll get black image
+
+        // we want to work with the whole image
+        //
+        VkImageSubresourceRange rangeWholeImage = WholeImageRange();
+
+        VkImageSubresourceLayers shittylayers = {};
+        shittylayers.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        shittylayers.mipLevel = 0;
+        shittylayers.baseArrayLayer = 0;
+        shittylayers.layerCount = 1;
+
+        VkBufferImageCopy wholeRegion = {};
+        wholeRegion.bufferOffset = 0;
+        wholeRegion.bufferRowLength = uint32_t(a_width);
+        wholeRegion.bufferImageHeight = uint32_t(a_height);
+        wholeRegion.imageExtent =
+            VkExtent3D{uint32_t(a_width), uint32_t(a_height), 1};
+        wholeRegion.imageOffset = VkOffset3D{0, 0, 0};
+        wholeRegion.imageSubresource = shittylayers;
+
+        // at first we must move our images to 'VK_IMAGE_LAYOUT_GENERAL' layout
+        // to further clear them
+        //
+        VkImageMemoryBarrier moveToGeneralBar = imBarTransfer(
+            a_images[0], rangeWholeImage, VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+        vkCmdPipelineBarrier(a_cmdBuff, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                             nullptr,                // general memory barriers
+                             0, nullptr,             // buffer barriers
+                             1, &moveToGeneralBar);  // image  barriers
+
+        // now we can clear images
+        //
+        VkClearColorValue clearVal = {};
+        clearVal.float32[0] = 1.0f;
+        clearVal.float32[1] = 1.0f;
+        clearVal.float32[2] = 1.0f;
+        clearVal.float32[3] = 1.0f;
+
+        vkCmdClearColorImage(a_cmdBuff, a_images[0],
+                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearVal, 1,
+                             &rangeWholeImage);  // clear image with (1,1,1,1)
+
+        vkCmdCopyBufferToImage(a_cmdBuff, a_bufferDynamic, a_images[0],
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                               &wholeRegion);
+
+        // transfer our texture from VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL to
+        // VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+        VkImageMemoryBarrier imgBar =
+            {};  // imBarTransfer(a_images[0], rangeWholeImage,
+                 // VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                 // VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        {
+            imgBar.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            imgBar.pNext = nullptr;
+            imgBar.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imgBar.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+            imgBar.srcAccessMask = 0;
+            imgBar.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            imgBar.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            imgBar.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            imgBar.image = a_images[0];
+
+            imgBar.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            imgBar.subresourceRange.baseMipLevel = 0;
+            imgBar.subresourceRange.levelCount = 1;
+            imgBar.subresourceRange.baseArrayLayer = 0;
+            imgBar.subresourceRange.layerCount = 1;
+        };
+
+        vkCmdPipelineBarrier(a_cmdBuff, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0,
+                             nullptr, 0, nullptr, 1, &imgBar);
+        writeTimestamp(a_cmdBuff, a_timestamps,
+                       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 1);
+
+        VK_CHECK_RESULT(
+            vkEndCommandBuffer(a_cmdBuff));  // end recording commands.
+    }
+
+    static void runCommandBuffer(VkCommandBuffer a_cmdBuff, VkQueue a_queue,
+                                 VkDevice a_device)
+    {
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;  // submit a single command buffer
+        submitInfo.pCommandBuffers =
+            &a_cmdBuff;  // the command buffer to submit.
+
+        VkFence fence;
+        VkFenceCreateInfo fenceCreateInfo = {};
+        fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceCreateInfo.flags = 0;
+        VK_CHECK_RESULT(
+            vkCreateFence(a_device, &fenceCreateInfo, NULL, &fence));
+        VK_CHECK_RESULT(vkQueueSubmit(a_queue, 1, &submitInfo, fence));
+        VK_CHECK_RESULT(
+            vkWaitForFences(a_device, 1, &fence, VK_TRUE, 100000000000));
+
+        vkDestroyFence(a_device, fence, NULL);
+    }
+
+    void cleanup()
+    {
+        if (enableValidationLayers) {
+            auto func =
+                (PFN_vkDestroyDebugReportCallbackEXT)vkGetInstanceProcAddr(
+                    instance, "vkDestroyDebugReportCallbackEXT");
+            if (func == nullptr) {
+                throw std::runtime_error(
+                    "Could not load vkDestroyDebugReportCallbackEXT");
+            }
+            func(instance, debugReportCallback, NULL);
+        }
+
+        for (FrameSlot &slot : slots) {
+            destroyFrameBuffers(slot);
+            vkDestroyFence(device, slot.fence, NULL);
+            vkDestroySemaphore(device, slot.uploaded, NULL);
+            vkDestroySemaphore(device, slot.filtered, NULL);
+        }
+        vkDestroyCommandPool(device, transferPool, NULL);
+        vkDestroyQueryPool(device, timestampPool, NULL);
+        destroyPipelines();
+        vkDestroyDescriptorPool(device, descriptorPool, NULL);
+        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, NULL);
+        vkDestroyPipelineLayout(device, pipelineLayout, NULL);
+        vkDestroyCommandPool(device, commandPool, NULL);
+        vkDestroyDevice(device, NULL);
+        vkDestroyInstance(instance, NULL);
+    }
+
+    void cleanupImage()
+    {
+        if (enableValidationLayers) {
+            auto func =
+                (PFN_vkDestroyDebugReportCallbackEXT)vkGetInstanceProcAddr(
+                    instance, "vkDestroyDebugReportCallbackEXT");
+            if (func == nullptr) {
+                throw std::runtime_error(
+                    "Could not load vkDestroyDebugReportCallbackEXT");
+            }
+            func(instance, debugReportCallback, NULL);
+        }
+        vkFreeMemory(device, imageMemory, NULL);
+        vkFreeMemory(device, bufferMemoryDynamic, NULL);
+        vkFreeMemory(device, bufferMemoryStaging, NULL);
+        vkFreeMemory(device, bufferMemoryGPU, NULL);
+        vkDestroySampler(device, sampler, NULL);
+        vkDestroyImageView(device, imageView, NULL);
+        vkDestroyBuffer(device, bufferStaging, NULL);
+        vkDestroyBuffer(device, bufferDynamic, NULL);
+        vkDestroyBuffer(device, bufferGPU, NULL);
+        vkDestroyImage(device, image, NULL);
+        vkDestroyQueryPool(device, timestampPool, NULL);
+        destroyPipelines();
+        vkDestroyDescriptorPool(device, descriptorPool, NULL);
+        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, NULL);
+        vkDestroyPipelineLayout(device, pipelineLayout, NULL);
+        vkDestroyCommandPool(device, commandPool, NULL);
+        vkDestroyDevice(device, NULL);
+        vkDestroyInstance(instance, NULL);
+    }
+};
+
+class CPUApp {
+public:
+    static void run(const FilterParams &a_params)
+    {
+        std::unique_ptr<PlanarImage> src = load(a_params);
+        const unsigned int width = src->width(), height = src->height();
+        PlanarImage dst(width, height);
+
+        filterPlanar(*src, dst, a_params);
+
+        std::vector<unsigned char> image(size_t(width) * height * 4);
+        toRgba8(dst, &image[0], 4 * size_t(width));
+        writeImage(a_params.output, width, height, &image[0]);
+    }
+
+    // The input as planes; raw frames are converted from their mapping
+    // without an interleaved float copy.
+    static std::unique_ptr<PlanarImage> load(const FilterParams &a_params)
+    {
+        std::unique_ptr<PlanarImage> src;
+        if (isRawFrameFile(a_params.input)) {
+            RawFrame raw(a_params.input);
+            src.reset(new PlanarImage(raw.width(), raw.height()));
+            raw.toPlanar(*src, a_params.threads);
+            return src;
+        }
+
+        int width = 0, height = 0, texChannels;
+        float *oldData = stbi_loadf(a_params.input.c_str(), &width, &height,
+                                    &texChannels, STBI_rgb_alpha);
+        if (!oldData) {
+            throw std::runtime_error("failed to load " + a_params.input);
+        }
+        src.reset(new PlanarImage(width, height));
+        src->fromInterleaved(oldData);
+        stbi_image_free(oldData);
+        return src;
+    }
+
+    // Runs the CPU engine a_params selects on a_params.threads threads.
+    static void filterPlanar(const PlanarImage &src, PlanarImage &dst,
+                             const FilterParams &a_params)
+    {
+        if (a_params.filter == nlm &&
+            a_params.nlmParams.kernel == integral) {
+            IntegralNlmFilter n(src, dst, a_params.nlmParams);
+            n.setThreads(a_params.threads);
+            n.run();
+        }
+        else if (a_params.filter == nlm) {
+            NlmFilter n(src, dst, a_params.nlmParams);
+            n.setThreads(a_params.threads);
+            n.run();
+        }
+        else if (a_params.runMode == cpuSimd) {
+            if (a_params.verbose) {
+                std::cout << "bilateral kernel: " << SimdBilateralFilter::isa()
+                          << std::endl;
+            }
+            SimdBilateralFilter b(src, dst, a_params.bilateralParams);
+            b.setThreads(a_params.threads);
+            b.run();
+        }
+        else if (a_params.runMode == cpuFast) {
+            FastBilateralFilter b(src, dst, a_params.bilateralParams);
+            b.setThreads(a_params.threads);
+            b.run();
+        }
+        else {
+            BilateralFilter b(src, dst, a_params.bilateralParams);
+            b.setThreads(a_params.threads);
+            b.run();
+        }
+    }
+
+    // a_image as 8-bit RGBA rows a_stride bytes apart, clamped to [0, 1]
+    // and truncated like the GPU readback.
+    static void toRgba8(const PlanarImage &a_image, unsigned char *a_dst,
+                        size_t a_stride)
+    {
+        for (int i = 0; i < int(a_image.height()); ++i) {
+            unsigned char *out = a_dst + a_stride * i;
+            for (int c = 0; c < PlanarImage::channels; ++c) {
+                const float *row = a_image.row(c, i);
+                for (int j = 0; j < int(a_image.width()); ++j) {
+                    const float v = std::min(std::max(0.0f, row[j]), 1.0f);
+                    out[4 * j + c] = (unsigned char)(255.0f * v);
+                }
+            }
+        }
+    }
+};
+
+Context::Context(const FilterParams &a_params) : params(a_params)
+{
+    if (params.runMode == gpu) {
+        gpu.reset(new ComputeApplication());
+        gpu->open(params);
+    }
+}
+
+Context::~Context()
+{
+    if (gpu) {
+        gpu->close();
+    }
+}
+
+void Context::filter(const ConstImageRef &a_src, const ImageRef &a_dst,
+                     const FilterParams &a_params)
+{
+    if (a_src.width != a_dst.width || a_src.height != a_dst.height) {
+        throw std::runtime_error("source and destination sizes differ");
+    }
+    if (gpu) {
+        gpu->filter(a_src.data, a_src.stride, a_dst.data, a_dst.stride,
+                    a_src.width, a_src.height, a_params);
+        return;
+    }
+
+    FilterParams cpuParams = params;
+    cpuParams.bilateralParams = a_params.bilateralParams;
+    cpuParams.nlmParams = a_params.nlmParams;
+    cpuParams.nlmParams.kernel = params.nlmParams.kernel;
+    PlanarImage src(a_src.width, a_src.height);
+    PlanarImage dst(a_src.width, a_src.height);
+    std::vector<float> rgba(4 * size_t(a_src.width) * a_src.height);
+    for (unsigned int i = 0; i < a_src.height; ++i) {
+        rgba8ToFloat(a_src.data + a_src.stride * i, a_src.width,
+                     &rgba[4 * size_t(a_src.width) * i]);
+    }
+    src.fromInterleaved(&rgba[0]);
+    CPUApp::filterPlanar(src, dst, cpuParams);
+    CPUApp::toRgba8(dst, a_dst.data, a_dst.stride);
+}
+
+void run(const FilterParams &a_params)
+{
+    if (a_params.runMode == gpu) {
+        ComputeApplication app;
+        app.run(a_params);
+    }
+    else if (a_params.runMode == cpuBench) {
+        runThreadScalingBenchmark(BENCH_WIDTH, BENCH_HEIGHT,
+                                  omp_get_num_procs(), a_params.bilateralParams);
+    }
+    else {
+        CPUApp::run(a_params);
+    }
+}
+
+}  // namespace vkfilter
@@ -0,0 +1,63 @@
+#ifndef VKFILTER_HPP
+#define VKFILTER_HPP
+
+#include <cstddef>
+#include <memory>
+#include "filter_params.hpp"
+
+// The filter engine without the command line: vulkan_minimal_compute is a
+// thin client of it, other programs link libvkfilter the same way.
+namespace vkfilter {
+
+// 8-bit RGBA pixels in caller memory, rows stride bytes apart.
+struct ConstImageRef {
+    const unsigned char *data;
+    unsigned int width;
+    unsigned int height;
+    size_t stride;
+};
+
+struct ImageRef {
+    unsigned char *data;
+    unsigned int width;
+    unsigned int height;
+    size_t stride;
+};
+
+class ComputeApplication;
+
+// Holds what is expensive to set up once: with runMode gpu the device, the
+// frame slots, the pipelines and the pipeline cache; the CPU modes need
+// nothing. Not thread safe, one filter() at a time.
+class Context {
+public:
+    explicit Context(const FilterParams &a_params);
+    ~Context();
+
+    Context(const Context &) = delete;
+    Context &operator=(const Context &) = delete;
+
+    // Filters a_src into a_dst, both a_src.width x a_src.height. a_params
+    // may change the bilateral and NLM numbers from call to call; the mode,
+    // filter, kernel, pixel format and tiling stay those of the constructor.
+    // The RGBA8 samples are filtered in their own encoding: unlike the file
+    // path, no gamma is applied on the way in, so none is owed on the way
+    // out.
+    // Page-aligned buffers with unpadded rows are imported by the device
+    // instead of copied where VK_EXT_external_memory_host allows it.
+    void filter(const ConstImageRef &a_src, const ImageRef &a_dst,
+                const FilterParams &a_params);
+
+private:
+    FilterParams params;
+    std::unique_ptr<ComputeApplication> gpu;
+};
+
+// What the executable does with parsed options: filter the input file(s)
+// into the output(s), or run the CPU thread scaling benchmark. Throws
+// std::runtime_error on failure.
+void run(const FilterParams &a_params);
+
+}  // namespace vkfilter
+
+#endif // VKFILTER_HPP